@@ -0,0 +1,257 @@
+#include <benchmark/benchmark.h>
+#include <random>
+#include <string>
+#include <vector>
+#include "batch_pipeline.hpp"
+#include "fm_index.hpp"
+#include "saca_k.hpp"
+
+// Run with --benchmark_out=FILE --benchmark_out_format=json (or
+// --benchmark_format=json for stdout) for machine readable results.
+
+/// @brief Random seq over ranks [1, k) with $ (0) at the end. With
+///        repeat percent r, about r% of the seq are copies of earlier
+///        parts with 1% mutations, like a collection of genomes.
+std::vector<uint8_t> make_seq(std::size_t n, int k, int repeat)
+{
+    std::default_random_engine eng(n * 31 + k * 7 + repeat);
+    std::uniform_int_distribution<int> chr(1, k - 1);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::vector<uint8_t> seq(n, 0);
+    constexpr std::size_t segment = 1000;
+    for (std::size_t i = 0; i + 1 < n; )
+    {
+        auto end = std::min(i + segment, n - 1);
+        if (i >= segment && percent(eng) < repeat)
+        {
+            std::uniform_int_distribution<std::size_t> from(0, i - segment);
+            auto src = from(eng);
+            for (; i < end; i++, src++)
+                seq[i] = (percent(eng) == 0) ? chr(eng) : seq[src];
+        }
+        else
+            for (; i < end; i++)
+                seq[i] = chr(eng);
+    }
+    return seq;
+}
+
+/// @brief Random DNA string with 'A' as $ at the end
+std::string make_dna(std::size_t n)
+{
+    std::default_random_engine eng(n);
+    std::uniform_int_distribution<int> dist(0, 3);
+    std::string seq(n, 'A');
+    std::generate(seq.begin(), seq.end() - 1,
+        [&eng, &dist](){ return "ACGT"[dist(eng)]; });
+    return seq;
+}
+
+/// @brief Patterns sampled from seq, so every one occurs
+std::vector<std::string> make_patterns(
+    const std::string& seq, std::size_t len, std::size_t count)
+{
+    std::default_random_engine eng(len);
+    std::uniform_int_distribution<std::size_t> pos(0, seq.size() - len - 1);
+    std::vector<std::string> patterns;
+    for (std::size_t i = 0; i < count; i++)
+        patterns.push_back(seq.substr(pos(eng), len));
+    return patterns;
+}
+
+using DnaFmIndex = FmIndex<
+    std::string, uint32_t, 2, SACA_K, BlockOcc, DnaAlphabet>;
+
+/// @brief Ranks as their own characters, for the make_seq() texts
+struct ByteAlphabet
+{
+    uint8_t operator()(uint8_t c) const
+    { return c; }
+};
+
+/// @brief Args: seq size, alphabet size, repeat percent
+template<class SA>
+void BM_SacaK(benchmark::State& state)
+{
+    auto seq = make_seq(state.range(0), state.range(1), state.range(2));
+    SA sa(seq.size());
+    for (auto _ : state)
+    {
+        SACA_K<decltype(seq), SA> sa_builder;
+        sa_builder.build(seq, sa, state.range(1));
+        benchmark::DoNotOptimize(sa.begin());
+    }
+    state.SetItemsProcessed(state.iterations() * seq.size());
+}
+BENCHMARK_TEMPLATE(BM_SacaK, std::vector<uint32_t>)
+    ->ArgsProduct({{1 << 16, 1 << 20, 1 << 22}, {4, 256}, {0, 90}})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_SacaK, std::vector<uint64_t>)
+    ->ArgsProduct({{1 << 20}, {4}, {0, 90}})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_SacaK, Int40Vector)
+    ->ArgsProduct({{1 << 20}, {4}, {0, 90}})
+    ->Unit(benchmark::kMillisecond);
+
+/// @brief Args: seq size, sample rate
+void BM_FmIndexBuild(benchmark::State& state)
+{
+    auto seq = make_dna(state.range(0));
+    for (auto _ : state)
+    {
+        DnaFmIndex fm_index(seq, state.range(1));
+        benchmark::DoNotOptimize(&fm_index);
+    }
+    state.SetItemsProcessed(state.iterations() * seq.size());
+}
+BENCHMARK(BM_FmIndexBuild)
+    ->ArgsProduct({{1 << 20}, {1, 4, 16, 64}})
+    ->Unit(benchmark::kMillisecond);
+
+/// @brief Random rows of a seq of size n, drawn before the timed loop
+///        so that it measures the index only. Count is a power of 2.
+std::vector<uint32_t> make_rows(std::size_t n, std::size_t count)
+{
+    std::default_random_engine eng(n);
+    std::uniform_int_distribution<uint32_t> row(0, n - 1);
+    std::vector<uint32_t> rows(count);
+    for (auto& r : rows)
+        r = row(eng);
+    return rows;
+}
+
+void BM_LfMapping(benchmark::State& state)
+{
+    auto seq = make_dna(1 << 22);
+    DnaFmIndex fm_index(seq, 16);
+    auto rows = make_rows(seq.size(), 1 << 16);
+    std::string chars(rows.size(), 'A');
+    for (std::size_t i = 0; i < rows.size(); i++)
+        chars[i] = "ACGT"[rows[(i + 1) & (rows.size() - 1)] & 3];
+    std::size_t i = 0;
+    for (auto _ : state)
+    {
+        auto j = i++ & (rows.size() - 1);
+        benchmark::DoNotOptimize(fm_index.lf_mapping(rows[j], chars[j]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LfMapping);
+
+/// @brief Args: sample rate
+void BM_GetLocation(benchmark::State& state)
+{
+    auto seq = make_dna(1 << 22);
+    DnaFmIndex fm_index(seq, state.range(0));
+    auto rows = make_rows(seq.size(), 1 << 16);
+    std::size_t i = 0;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(
+            fm_index.get_location(rows[i++ & (rows.size() - 1)]));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetLocation)->Arg(1)->Arg(16)->Arg(64);
+
+/// @brief Args: pattern length, k-mer table length (0 for none)
+void BM_Count(benchmark::State& state)
+{
+    auto seq = make_dna(1 << 22);
+    DnaFmIndex fm_index(seq, 16, 1, state.range(1));
+    auto patterns = make_patterns(seq, state.range(0), 1 << 12);
+    std::size_t i = 0;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(
+            fm_index.count(patterns[i++ & (patterns.size() - 1)]));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Count)->ArgsProduct({{16, 64}, {0, 10}});
+
+/// @brief Args: pattern length, batch window
+void BM_CountBatch(benchmark::State& state)
+{
+    auto seq = make_dna(1 << 22);
+    DnaFmIndex fm_index(seq, 16);
+    auto patterns = make_patterns(seq, state.range(0), 1 << 12);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(
+            fm_index.count_batch(patterns, state.range(1)));
+    state.SetItemsProcessed(state.iterations() * patterns.size());
+}
+BENCHMARK(BM_CountBatch)->ArgsProduct({{16, 64}, {1, 32}})
+    ->Unit(benchmark::kMillisecond);
+
+/// @brief Args: sample rate
+void BM_Locate(benchmark::State& state)
+{
+    auto seq = make_dna(1 << 22);
+    DnaFmIndex fm_index(seq, state.range(0));
+    auto patterns = make_patterns(seq, 20, 1 << 12);
+    std::size_t i = 0, hits = 0;
+    for (auto _ : state)
+        hits += fm_index.locate(
+            patterns[i++ & (patterns.size() - 1)]).size();
+    state.SetItemsProcessed(state.iterations());
+    state.counters["hits"] = benchmark::Counter(
+        hits, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_Locate)->Arg(4)->Arg(16);
+
+/// @brief Locate batches of reads through BatchPipeline as fm_search
+///        does, in real time to show the scaling. Args: threads
+void BM_BatchSearch(benchmark::State& state)
+{
+    auto seq = make_dna(1 << 22);
+    DnaFmIndex fm_index(seq, 16);
+    auto reads = make_patterns(seq, 100, 1 << 16);
+    BatchPipeline<std::size_t, std::size_t> pipeline(state.range(0));
+    constexpr std::size_t batch_size = 1024;
+    for (auto _ : state)
+    {
+        std::size_t next = 0, hits = 0;
+        pipeline.run(
+            [&next, &reads](std::size_t& batch)
+            {
+                batch = next;
+                next += batch_size;
+                return batch < reads.size();
+            },
+            [&fm_index, &reads](std::size_t& batch, std::size_t& out
+                              , unsigned)
+            {
+                out = 0;
+                for (auto i = batch; i < batch + batch_size; i++)
+                    out += fm_index.locate(reads[i]).size();
+            },
+            [&hits](std::size_t& out){ hits += out; });
+        benchmark::DoNotOptimize(hits);
+    }
+    state.SetItemsProcessed(state.iterations() * reads.size());
+}
+BENCHMARK(BM_BatchSearch)->Arg(1)->Arg(2)->Arg(4)->Arg(8)
+    ->UseRealTime()->Unit(benchmark::kMillisecond);
+
+/// @brief Count over 8-bit text by occ backend. Args: alphabet size
+template<template<typename, int> class OCC>
+void BM_CountBytes(benchmark::State& state)
+{
+    auto seq = make_seq(1 << 22, state.range(0), 0);
+    FmIndex<std::vector<uint8_t>, uint32_t, 8, SACA_K, OCC, ByteAlphabet>
+        fm_index(seq, 16);
+    std::default_random_engine eng;
+    std::uniform_int_distribution<std::size_t> pos(0, seq.size() - 13);
+    std::vector<std::vector<uint8_t>> patterns;
+    for (auto i = 0; i < 1 << 12; i++)
+    {
+        auto begin = seq.begin() + pos(eng);
+        patterns.emplace_back(begin, begin + 12);
+    }
+    std::size_t i = 0;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(
+            fm_index.count(patterns[i++ & (patterns.size() - 1)]));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_CountBytes, BlockOcc)->Arg(20)->Arg(256);
+BENCHMARK_TEMPLATE(BM_CountBytes, WaveletOcc)->Arg(20)->Arg(256);
+
+BENCHMARK_MAIN();
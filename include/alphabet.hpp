@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+
+// Alphabet policies map a character to its lexicographic rank. A
+// policy is a callable `rank = map(c)`. Stateless policies are
+// resolved at compile time and inlined into every loop using them.
+
+/// @brief Alphabet given by a mapper at runtime, called through
+///        std::function (can not be inlined)
+template<typename CHAR, typename INDEX>
+class RuntimeAlphabet
+{
+    std::function<INDEX(CHAR)> map_;
+
+  public:
+    RuntimeAlphabet() = default;
+
+    template<class MAPPER, class = std::enable_if_t<
+        std::is_constructible<std::function<INDEX(CHAR)>, MAPPER>::value
+    >>
+    RuntimeAlphabet(MAPPER map)
+        : map_(map)
+    {}
+
+    INDEX operator()(CHAR c) const
+    { return map_(c); }
+};
+
+/// @brief Byte to rank lookup table
+struct RankTable
+{
+    uint8_t rank[256];
+};
+
+/// @brief A/C/G/T (either case) to 0/1/2/3, other characters
+///        (including N) to 0
+constexpr RankTable make_dna_table()
+{
+    RankTable table {};
+    table.rank['C'] = table.rank['c'] = 1;
+    table.rank['G'] = table.rank['g'] = 2;
+    table.rank['T'] = table.rank['t'] = 3;
+    return table;
+}
+
+/// @brief DNA alphabet by a constexpr lookup table. Characters other
+///        than ACGT map to A, sanitize seq and patterns beforehand if
+///        that matters.
+struct DnaAlphabet
+{
+    uint8_t operator()(char c) const
+    {
+        static constexpr RankTable table = make_dna_table();
+        return table.rank[static_cast<unsigned char>(c)];
+    }
+};
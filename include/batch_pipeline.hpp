@@ -0,0 +1,258 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief Reader/worker/writer pipeline processing a stream of batches
+///        in parallel and writing the results in input order. The
+///        calling thread reads batches and deals them round-robin to
+///        the workers' queues; a worker takes from the front of its
+///        own queue and, once it is empty, steals from the front of
+///        the others', so a slow batch does not hold the batches
+///        queued behind it. A writer thread writes each result as soon
+///        as those of all earlier batches are written. At most
+///        max_pending batches are read but not written, which bounds
+///        memory whatever the relative speeds. An exception thrown by
+///        any stage stops the pipeline and is rethrown by run() once
+///        every thread is joined, the batches left being dropped.
+/// @tparam IN Batch read
+/// @tparam OUT Result of a batch
+template<class IN, class OUT>
+class BatchPipeline
+{
+    /// @brief A batch and its input order
+    struct Task
+    {
+        uint64_t id;
+        IN       in;
+    };
+
+    /// @brief Queue of one worker, stolen from by the others
+    struct Queue
+    {
+        std::mutex       mutex;
+        std::deque<Task> tasks;
+    };
+
+    unsigned                            threads_;
+    std::size_t                         max_pending_;
+    std::vector<std::unique_ptr<Queue>> queues_;
+
+    std::mutex                          mutex_;
+    std::condition_variable             work_cv_;
+    std::condition_variable             write_cv_;
+    std::condition_variable             read_cv_;
+
+    /// @brief Tasks queued and not yet claimed by a worker
+    std::size_t                         queued_ = 0;
+
+    /// @brief No more batches are read
+    bool                                closed_ = false;
+
+    /// @brief Every batch is processed
+    bool                                finished_ = false;
+
+    /// @brief Results waiting for those of earlier batches
+    std::map<uint64_t, OUT>             done_;
+    uint64_t                            written_ = 0;
+
+    /// @brief First exception of a stage, stops every stage
+    std::exception_ptr                  error_;
+
+  public:
+    /// @param threads Number of workers, 0 for all hardware threads
+    /// @param max_pending Most batches read but not written, 0 for
+    ///        4 per worker
+    explicit BatchPipeline(unsigned threads, std::size_t max_pending = 0)
+        : threads_(threads ? threads
+                 : std::max(1u, std::thread::hardware_concurrency()))
+        , max_pending_(max_pending ? max_pending : 4 * threads_)
+    {
+        for (unsigned i = 0; i < threads_; i++)
+            queues_.emplace_back(new Queue);
+    }
+
+    unsigned threads() const
+    { return threads_; }
+
+    /// @brief Run the pipeline until read() returns false
+    /// @param read bool(IN&), fill the next batch, false at the end
+    /// @param process void(IN&, OUT&, unsigned tid), in a worker
+    /// @param write void(OUT&), in the writer thread, in input order
+    /// @throw The first exception thrown by read, process or write
+    template<class READ, class PROCESS, class WRITE>
+    void run(READ read, PROCESS process, WRITE write)
+    {
+        closed_ = finished_ = false;
+        done_.clear();
+        written_ = 0;
+        error_ = nullptr;
+
+        std::vector<std::thread> workers;
+        for (unsigned tid = 0; tid < threads_; tid++)
+            workers.emplace_back([this, tid, &process]
+                { work(tid, process); });
+        std::thread writer([this, &write]{ write_all(write); });
+
+        try
+        {
+            uint64_t id = 0;
+            for (IN in; read(in); in = IN(), id++)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    read_cv_.wait(lock, [this, id]
+                        { return id - written_ < max_pending_ || error_; });
+                    if (error_)
+                        break;
+                }
+                {
+                    auto& queue = *queues_[id % threads_];
+                    std::lock_guard<std::mutex> lock(queue.mutex);
+                    queue.tasks.push_back({id, std::move(in)});
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    queued_++;
+                }
+                work_cv_.notify_one();
+            }
+        }
+        catch (...)
+        {
+            fail();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        work_cv_.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            finished_ = true;
+        }
+        write_cv_.notify_all();
+        writer.join();
+
+        if (error_)
+        {
+            // drop the batches no worker took
+            for (auto& queue : queues_)
+                queue->tasks.clear();
+            queued_ = 0;
+            done_.clear();
+            std::rethrow_exception(error_);
+        }
+    }
+
+  private:
+    template<class PROCESS>
+    void work(unsigned tid, PROCESS& process)
+    {
+        while (true)
+        {
+            // claim one of the queued tasks, then find it
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                work_cv_.wait(lock, [this]{ return queued_ || closed_; });
+                if (queued_ == 0 || error_)
+                    return;
+                queued_--;
+            }
+            Task task;
+            auto i = tid;
+            while (!take(*queues_[i % threads_], task))
+                i++;
+
+            OUT out;
+            try
+            {
+                process(task.in, out, tid);
+            }
+            catch (...)
+            {
+                fail();
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                done_.emplace(task.id, std::move(out));
+            }
+            write_cv_.notify_one();
+        }
+    }
+
+    static bool take(Queue& queue, Task& task)
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+            return false;
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+
+    /// @brief Write results in order until every batch is processed
+    ///        and written
+    template<class WRITE>
+    void write_all(WRITE& write)
+    {
+        while (true)
+        {
+            OUT out;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                write_cv_.wait(lock, [this]
+                    {
+                        return (!done_.empty()
+                             && done_.begin()->first == written_)
+                            || finished_ || error_;
+                    });
+                // once finished, the results left are all in order
+                if (done_.empty() || error_)
+                    return;
+                out = std::move(done_.begin()->second);
+                done_.erase(done_.begin());
+            }
+            try
+            {
+                write(out);
+            }
+            catch (...)
+            {
+                fail();
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                written_++;
+            }
+            read_cv_.notify_one();
+        }
+    }
+
+    /// @brief Keep the exception being handled if it is the first and
+    ///        wake every stage to stop
+    void fail()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_)
+                error_ = std::current_exception();
+            closed_ = true;
+        }
+        work_cv_.notify_all();
+        write_cv_.notify_all();
+        read_cv_.notify_all();
+    }
+};
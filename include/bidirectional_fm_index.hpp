@@ -0,0 +1,470 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "fm_index.hpp"
+
+/// @brief Bidirectional fm-index: an FmIndex of the seq and one of its
+///        reverse, whose bwt intervals are kept synchronized so a
+///        match can be extended to the left as well as to the right
+///        (Lam et al., 2009). Extending one side by c lf-maps that
+///        side's interval for every character at once, the other
+///        side's interval then starts after the rows of the smaller
+///        characters (and of $). Locations come from the forward
+///        index; the reverse one samples a single location.
+/// @tparam SEQ, INDEX, BITS, SORTER, OCC, ALPHABET, INDEX_VECTOR See
+///         FmIndex
+template<
+    typename SEQ
+  , typename INDEX
+  , int BITS
+  , template<typename, typename> typename SORTER
+  , template<typename, int> typename OCC = BlockOcc
+  , typename ALPHABET = RuntimeAlphabet<typename SEQ::value_type, INDEX>
+  , typename INDEX_VECTOR = std::vector<INDEX>
+>
+class BidirectionalFmIndex
+{
+  public:
+    using FmIndexType = FmIndex<
+        SEQ, INDEX, BITS, SORTER, OCC, ALPHABET, INDEX_VECTOR>;
+    using CharType    = typename SEQ::value_type;
+    using ApproxRange = typename FmIndexType::ApproxRange;
+
+    /// @brief Synchronized intervals of a pattern P: rows [fwd, fwd +
+    ///        size) of the forward bwt are the suffixes prefixed by P,
+    ///        rows [rev, rev + size) of the reverse bwt those prefixed
+    ///        by the reverse of P
+    struct Interval
+    {
+        INDEX fwd;
+        INDEX rev;
+        INDEX size;
+    };
+
+    /// @brief Maximal exact match of pattern [begin, end) and its
+    ///        interval
+    struct Smem
+    {
+        std::size_t begin;
+        std::size_t end;
+        Interval    interval;
+    };
+
+  private:
+    static constexpr int alph_size = 1 << BITS;
+
+    /// @brief Search of a search scheme: the order the parts are
+    ///        matched in, and the bounds of the errors accumulated
+    ///        once each of them is matched
+    struct SchemeSearch
+    {
+        int      order[3];
+        unsigned lower[3];
+        unsigned upper[3];
+    };
+
+    /// @brief One character of a search: its pattern position, the
+    ///        side it extends and the error bounds after it
+    struct SchemeStep
+    {
+        std::size_t pos;
+        bool        left;
+        unsigned    lower;
+        unsigned    upper;
+    };
+
+    FmIndexType fwd_;
+    FmIndexType rev_;
+
+  public:
+    /// @param seq Sequence, required $(smalest alphabet) be inserted
+    ///        at the end
+    /// @param map Map alphabet to their rank
+    /// @param step Sample rate of the forward index, and of both
+    ///        occ if OCC samples the bwt
+    /// @param threads Number of threads, 0 for all hardware threads
+    /// @param kmer_len K of the forward k-mer table (used by
+    ///        count() and locate() of forward()), 0 for none
+    /// @param external Scratch space, empty to build in memory
+    template<class MAPPER, class = std::enable_if_t<
+        std::is_constructible<ALPHABET, MAPPER>::value>>
+    BidirectionalFmIndex(
+        const SEQ& seq
+      , MAPPER map
+      , INDEX step = 1
+      , unsigned threads = 1
+      , unsigned kmer_len = 0
+      , const ExternalMemory& external = ExternalMemory()
+    )
+        : fwd_(seq, map, step, threads, kmer_len, external)
+        , rev_(reversed(seq), map, single_sample(seq.size()), threads, 0
+             , external, step)
+    {}
+
+    /// @brief Build with a stateless alphabet policy, see above
+    template<class A = ALPHABET, class = std::enable_if_t<
+        std::is_empty<A>::value>>
+    explicit BidirectionalFmIndex(
+        const SEQ& seq
+      , INDEX step = 1
+      , unsigned threads = 1
+      , unsigned kmer_len = 0
+      , const ExternalMemory& external = ExternalMemory()
+    )
+        : BidirectionalFmIndex(seq, ALPHABET(), step, threads, kmer_len
+                             , external)
+    {}
+
+    /// @brief Interval of the empty pattern, every row
+    Interval whole() const
+    {
+        return Interval{0, 0, fwd_.size()};
+    }
+
+    /// @brief Interval of cP from that of P
+    Interval extend_left(const Interval& interval, CharType c) const
+    {
+        return extend(interval, fwd_.char_rank(c), true);
+    }
+
+    /// @brief Interval of Pc from that of P
+    Interval extend_right(const Interval& interval, CharType c) const
+    {
+        return extend(interval, fwd_.char_rank(c), false);
+    }
+
+    /// @brief Extend interval of P to that of cP (left) or Pc for
+    ///        every character c at once
+    /// @param intervals Extended interval, indexed by the rank of c
+    void extend_all(
+        const Interval& interval
+      , bool left
+      , std::array<Interval, alph_size>& intervals
+    ) const
+    {
+        typename FmIndexType::RangeTable ranges;
+        const auto& index = left ? fwd_ : rev_;
+        auto begin = left ? interval.fwd : interval.rev;
+        auto other = left ? interval.rev : interval.fwd;
+
+        // rows preceded by $ sort first on the other side, then those
+        // of each character in order
+        other += index.extend_all(
+            std::make_pair(begin, begin + interval.size), ranges);
+        for (auto c = 0; c < alph_size; c++)
+        {
+            auto size = ranges[c].second - ranges[c].first;
+            intervals[c] = left ? Interval{ranges[c].first, other, size}
+                                : Interval{other, ranges[c].first, size};
+            other += size;
+        }
+    }
+
+    /// @brief Find the super-maximal exact matches (SMEMs) of pattern,
+    ///        the exact matches occurring at least min_occ times that
+    ///        can not be extended either way and are not contained in
+    ///        another. From a start position x, the match is extended
+    ///        to the right, keeping the interval each time it shrinks,
+    ///        then all of them are extended to the left together,
+    ///        emitting those which stop growing before a longer one
+    ///        (Li, 2012). The next start is the end of the longest
+    ///        match. With min_occ > 1 the matches are the longest ones
+    ///        occurring that often, for re-seeding repetitive regions.
+    /// @param min_len Minimum match length reported
+    /// @param max_occ Drop matches occurring more often, 0 for no cap
+    /// @param min_occ Minimum number of occurrences of a match, at
+    ///        least 1
+    /// @return Matches by increasing begin
+    template<class PATTERN>
+    std::vector<Smem> smems(
+        const PATTERN& pattern
+      , std::size_t min_len = 1
+      , INDEX max_occ = 0
+      , INDEX min_occ = 1
+    ) const
+    {
+        // a match must occur, the extension stops at empty intervals
+        if (min_occ == 0)
+            throw std::runtime_error("smems: min_occ must be at least 1");
+        std::vector<INDEX> ranks;
+        for (std::size_t i = 0; i < pattern.size(); i++)
+            ranks.push_back(fwd_.char_rank(pattern[i]));
+
+        std::vector<Smem> found, matches;
+        for (std::size_t x = 0; x < ranks.size(); )
+            x = smems_from(ranks, x, min_occ, found);
+        for (const auto& match : found)
+            if (match.end - match.begin >= min_len
+             && (max_occ == 0 || match.interval.size <= max_occ))
+                matches.push_back(match);
+        return matches;
+    }
+
+    /// @brief Find the strings within k mismatches of pattern. For
+    ///        k <= 2 the pattern is split into k + 1 parts and searched
+    ///        by the search schemes of Kucherov et al. (2016): each
+    ///        search matches the parts in its order, growing the match
+    ///        to the left or right, and bounds the errors accumulated
+    ///        after every part, so most branches die in the first,
+    ///        exact, part. Larger k (or patterns shorter than the
+    ///        parts) fall back to forward().search_mismatch().
+    /// @return Forward bwt interval of each matched string with its
+    ///         number of mismatches, sorted by interval
+    template<class PATTERN>
+    std::vector<ApproxRange> search_mismatch(
+        const PATTERN& pattern
+      , unsigned k
+    ) const
+    {
+        // Kucherov et al. schemes for 1 and 2 mismatches, the error
+        // bounds cover every distribution of errors among the parts
+        static const SchemeSearch one[] = {
+            {{0, 1}, {0, 0}, {0, 1}},
+            {{1, 0}, {0, 1}, {0, 1}}};
+        static const SchemeSearch two[] = {
+            {{0, 1, 2}, {0, 0, 0}, {0, 2, 2}},
+            {{2, 1, 0}, {0, 0, 0}, {0, 1, 2}},
+            {{1, 0, 2}, {0, 1, 1}, {0, 1, 2}}};
+
+        auto parts = k + 1;
+        if (k > 2 || pattern.size() < parts)
+            return fwd_.search_mismatch(pattern, k);
+
+        std::vector<INDEX> ranks;
+        for (std::size_t i = 0; i < pattern.size(); i++)
+            ranks.push_back(fwd_.char_rank(pattern[i]));
+
+        std::vector<ApproxRange> hits;
+        if (k == 0)
+        {
+            auto range = fwd_.get_range(pattern);
+            if (range.first < range.second)
+                hits.push_back({range.first, range.second, 0});
+            return hits;
+        }
+        const SchemeSearch* searches = (k == 1) ? one : two;
+        for (unsigned s = 0; s < parts; s++)
+        {
+            auto steps = scheme_steps(searches[s], parts, ranks.size());
+            scheme_search(ranks, steps, 0, whole(), 0, hits);
+        }
+
+        // searches may reach a string more than once
+        std::sort(hits.begin(), hits.end(),
+            [](const ApproxRange& a, const ApproxRange& b)
+            {
+                return std::tie(a.begin, a.end, a.errors)
+                     < std::tie(b.begin, b.end, b.errors);
+            });
+        hits.erase(std::unique(hits.begin(), hits.end(),
+            [](const ApproxRange& a, const ApproxRange& b)
+            { return a.begin == b.begin && a.end == b.end; })
+          , hits.end());
+        return hits;
+    }
+
+    /// @brief Interval of pattern, by extending to the left
+    template<class PATTERN>
+    Interval get_interval(const PATTERN& pattern) const
+    {
+        auto interval = whole();
+        for (auto i = pattern.size(); i-- > 0 && interval.size != 0; )
+            interval = extend_left(interval, pattern[i]);
+        return interval;
+    }
+
+    /// @brief Location in seq of each row of an interval, in row order
+    std::vector<INDEX> locate(const Interval& interval) const
+    {
+        return fwd_.locate_range(std::make_pair(
+            interval.fwd, interval.fwd + interval.size));
+    }
+
+    /// @brief Index of seq
+    const FmIndexType& forward() const
+    { return fwd_; }
+
+    /// @brief Index of the reverse of seq ($ kept at the end)
+    const FmIndexType& reverse() const
+    { return rev_; }
+
+    /// @brief Save to path (forward index) and path.rev (reverse
+    ///        index)
+    void save(const std::string& path) const
+    {
+        fwd_.save(path);
+        rev_.save(path + ".rev");
+    }
+
+    /// @brief Map files written by save(), see FmIndex::load()
+    static BidirectionalFmIndex load(const std::string& path)
+    {
+        return BidirectionalFmIndex(
+            FmIndexType::load(path), FmIndexType::load(path + ".rev"));
+    }
+
+    /// @brief Map files written by save() with a runtime mapper
+    template<class MAPPER>
+    static BidirectionalFmIndex load(const std::string& path, MAPPER map)
+    {
+        return BidirectionalFmIndex(FmIndexType::load(path, map)
+                                  , FmIndexType::load(path + ".rev", map));
+    }
+
+  private:
+    BidirectionalFmIndex(FmIndexType fwd, FmIndexType rev)
+        : fwd_(std::move(fwd))
+        , rev_(std::move(rev))
+    {}
+
+    /// @brief Interval of character rank c appended to the left or
+    ///        right
+    Interval extend(const Interval& interval, INDEX c, bool left) const
+    {
+        std::array<Interval, alph_size> intervals;
+        extend_all(interval, left, intervals);
+        return intervals[c];
+    }
+
+    /// @brief SMEMs containing position x, appended to found
+    /// @return End of the longest match from x, the next start
+    std::size_t smems_from(
+        const std::vector<INDEX>& ranks
+      , std::size_t x
+      , INDEX min_occ
+      , std::vector<Smem>& found
+    ) const
+    {
+        // matches from x, by decreasing interval size
+        std::vector<Smem> prev, curr;
+        Smem match {x, x + 1, extend(whole(), ranks[x], true)};
+        if (match.interval.size < min_occ)
+            return x + 1;
+        std::size_t i;
+        for (i = x + 1; i < ranks.size(); i++)
+        {
+            auto interval = extend(match.interval, ranks[i], false);
+            if (interval.size != match.interval.size)
+                curr.push_back(match);
+            if (interval.size < min_occ)
+                break;
+            match.interval = interval;
+            match.end = i + 1;
+        }
+        if (i == ranks.size())
+            curr.push_back(match);
+
+        // longest first, the shorter ones can only be emitted while
+        // no longer one still grows
+        std::reverse(curr.begin(), curr.end());
+        auto next = curr.front().end;
+        std::swap(prev, curr);
+        auto first_found = found.size();
+        for (auto j = x; ; j--)
+        {
+            curr.clear();
+            for (const auto& p : prev)
+            {
+                Interval interval {0, 0, 0};
+                if (j > 0)
+                    interval = extend(p.interval, ranks[j-1], true);
+                if (interval.size < min_occ)
+                {
+                    // p stops here, maximal unless a longer one (with
+                    // a smaller interval) is still growing, and not
+                    // contained in the last match found
+                    if (curr.empty() && (found.size() == first_found
+                                      || j < found.back().begin))
+                        found.push_back({j, p.end, p.interval});
+                }
+                else if (curr.empty()
+                      || interval.size != curr.back().interval.size)
+                    curr.push_back({j - 1, p.end, interval});
+            }
+            if (curr.empty())
+                break;
+            std::swap(prev, curr);
+        }
+        std::reverse(found.begin() + first_found, found.end());
+        return next;
+    }
+
+    /// @brief Characters of a search in matching order. The first
+    ///        part is matched right to left, a later part left of
+    ///        the match so far right to left, otherwise left to right.
+    static std::vector<SchemeStep> scheme_steps(
+        const SchemeSearch& search
+      , unsigned parts
+      , std::size_t size
+    )
+    {
+        std::vector<SchemeStep> steps;
+        auto first = search.order[0];
+        for (unsigned p = 0; p < parts; p++)
+        {
+            auto part = search.order[p];
+            auto begin = size * part / parts;
+            auto end = size * (part + 1) / parts;
+            bool left = (part <= first);
+            first = std::min(first, part);
+            for (auto j = begin; j < end; j++)
+                steps.push_back({left ? end - 1 - (j - begin) : j, left
+                               , 0, search.upper[p]});
+            steps.back().lower = search.lower[p];
+        }
+        return steps;
+    }
+
+    /// @brief Match steps [step, end) of a search from interval with
+    ///        errors so far
+    void scheme_search(
+        const std::vector<INDEX>& ranks
+      , const std::vector<SchemeStep>& steps
+      , std::size_t step
+      , const Interval& interval
+      , unsigned errors
+      , std::vector<ApproxRange>& hits
+    ) const
+    {
+        if (step == steps.size())
+        {
+            hits.push_back(
+                {interval.fwd, interval.fwd + interval.size, errors});
+            return;
+        }
+        const auto& s = steps[step];
+        std::array<Interval, alph_size> intervals;
+        extend_all(interval, s.left, intervals);
+        for (INDEX c = 0; c < alph_size; c++)
+        {
+            auto e = errors + (c != ranks[s.pos]);
+            if (intervals[c].size != 0 && e <= s.upper && e >= s.lower)
+                scheme_search(ranks, steps, step + 1, intervals[c], e
+                            , hits);
+        }
+    }
+
+    /// @brief Reverse of seq, $ kept at the end
+    static SEQ reversed(const SEQ& seq)
+    {
+        SEQ reversed(seq.rbegin() + 1, seq.rend());
+        reversed.push_back(seq.back());
+        return reversed;
+    }
+
+    /// @brief Sample rate locating a single row, the reverse index
+    ///        is never located. Its occ keeps the forward step (see
+    ///        FmIndex's occ_step), a SampledOcc would otherwise scan
+    ///        up to n/2 characters per query.
+    static INDEX single_sample(std::size_t size)
+    {
+        INDEX step = 1;
+        while (step <= size / 2)
+            step *= 2;
+        return step;
+    }
+};
@@ -0,0 +1,286 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <algorithm>
+#if defined(__POPCNT__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include "mapped_array.hpp"
+#include "packed_vector.hpp"
+#include "thread_pool.hpp"
+
+/// @brief Word with the lowest bit of every BITS-bit field set
+template<int BITS>
+constexpr uint64_t field_low_bits()
+{
+    uint64_t bits = 0;
+    for (int i = 0; i < 64 / BITS; i++)
+        bits |= uint64_t(1) << (i * BITS);
+    return bits;
+}
+
+/// @brief Occ backend interleaving counts with the packed bwt. Each
+///        block starts with the occurence of every character before
+///        the block, followed by the block's characters packed in
+///        BITS bits. For small alphabets a block is exactly one cache
+///        line (e.g. 4 x uint32_t counts + 192 DNA characters), so an
+///        lf step costs about one cache miss. Occurence inside a
+///        block is counted word by word with bit-parallel compare and
+///        popcount (AVX2 for 4 words at a time when available).
+template<typename INDEX, int BITS>
+class BlockOcc
+{
+  public:
+    /// @brief Tag stored in index files to detect backend mismatch
+    static constexpr uint32_t type_id = 2;
+
+    static constexpr int alph_size = 1 << BITS;
+
+    /// @brief Words holding the counts at the head of a block
+    static constexpr int count_words =
+        (alph_size * sizeof(INDEX) + 7) / 8;
+
+    /// @brief Words per block, at least as many character words as
+    ///        count words, rounded up to whole cache lines
+    static constexpr int block_words = (2 * count_words + 7) / 8 * 8;
+
+    static constexpr int symbol_words = block_words - count_words;
+    static constexpr int per_word     = 64 / BITS;
+
+    /// @brief Characters per block
+    static constexpr int block_size   = symbol_words * per_word;
+
+  private:
+    static constexpr uint64_t mask     = (uint64_t(1) << BITS) - 1;
+    static constexpr uint64_t low_bits = field_low_bits<BITS>();
+
+    MappedArray<uint64_t> blocks_;
+    INDEX                 size_ = 0;
+
+    /// @brief The index of $(sentinal) in bwt, stored as rank 0
+    INDEX                 primary_index_ = 0;
+
+  public:
+    BlockOcc() = default;
+
+    /// @param bwt Bwt as alphabet rank, any value at primary_index
+    /// @param primary_index The index of $ in bwt
+    /// @param threads Number of threads building the blocks
+    BlockOcc(const PackedVector<BITS>& bwt, INDEX primary_index
+           , INDEX = 1, unsigned threads = 1)
+        : size_(bwt.size())
+        , primary_index_(primary_index)
+    {
+        using CountType = std::array<INDEX, alph_size>;
+
+        // one extra block so that occ(size(), c) has its counts
+        std::size_t block_count = bwt.size() / block_size + 1;
+        blocks_.resize(block_count * block_words);
+
+        // Pack each chunk of blocks, with each block's own counts in
+        // its head for now, and count the chunk
+        ThreadPool pool(threads);
+        std::vector<CountType> chunk_count(pool.size() + 1);
+        pool.parallel_for(block_count,
+            [this, &bwt, &chunk_count](auto begin, auto end, auto tid)
+            {
+                for (auto b = begin; b < end; b++)
+                {
+                    auto block = &blocks_[b * block_words];
+                    CountType count {};
+                    std::size_t first = b * block_size;
+                    std::size_t last = std::min(
+                        first + block_size, bwt.size());
+                    for (auto i = first; i < last; i++)
+                    {
+                        uint64_t c = (i == primary_index_) ? 0 : bwt[i];
+                        auto offset = i - first;
+                        block[count_words + offset / per_word] |=
+                            c << (offset % per_word * BITS);
+                        count[c]++;
+                    }
+                    std::memcpy(block, count.data(), sizeof(count));
+                    for (auto c = 0; c < alph_size; c++)
+                        chunk_count[tid + 1][c] += count[c];
+                }
+            });
+
+        // Prefix sum over chunks, then over blocks in each chunk
+        for (std::size_t tid = 1; tid < chunk_count.size(); tid++)
+            for (auto c = 0; c < alph_size; c++)
+                chunk_count[tid][c] += chunk_count[tid - 1][c];
+        pool.parallel_for(block_count,
+            [this, &chunk_count](auto begin, auto end, auto tid)
+            {
+                auto count = chunk_count[tid];
+                for (auto b = begin; b < end; b++)
+                {
+                    auto block = &blocks_[b * block_words];
+                    CountType own;
+                    std::memcpy(own.data(), block, sizeof(own));
+                    std::memcpy(block, count.data(), sizeof(count));
+                    for (auto c = 0; c < alph_size; c++)
+                        count[c] += own[c];
+                }
+            });
+    }
+
+    /// @brief Get occurence of character c uptile bwt index i
+    /// @param i Bwt index
+    /// @param c Rank of character
+    /// @return Number of occurence
+    INDEX occ(INDEX i, INDEX c) const
+    {
+        auto block = blocks_.data()
+                   + std::size_t(i / block_size) * block_words;
+        INDEX count;
+        std::memcpy(&count
+                  , reinterpret_cast<const char*>(block)
+                      + c * sizeof(INDEX)
+                  , sizeof(INDEX));
+        count += rank(block + count_words, i % block_size, c);
+
+        // $ is stored as rank 0, do not count it
+        return count - (c == 0 && i > primary_index_);
+    }
+
+    /// @brief Hint that occ(i, c) or [i] is coming, fetch the block
+    ///        of i into cache
+    void prefetch(INDEX i) const
+    {
+        __builtin_prefetch(
+            blocks_.data() + std::size_t(i / block_size) * block_words);
+    }
+
+    /// @brief Rank of the i-th character in bwt
+    INDEX operator[](INDEX i) const
+    {
+        std::size_t offset = i % block_size;
+        auto word = blocks_[std::size_t(i / block_size) * block_words
+                          + count_words + offset / per_word];
+        return (word >> (offset % per_word * BITS)) & mask;
+    }
+
+    std::size_t size() const
+    { return size_; }
+
+    void save(std::ostream& os) const
+    {
+        save_pod(os, uint64_t(size_));
+        save_pod(os, uint64_t(primary_index_));
+        blocks_.save(os);
+    }
+
+    void map(const char*& ptr, const char* end)
+    {
+        uint64_t size, primary_index;
+        map_pod(ptr, end, size);
+        map_pod(ptr, end, primary_index);
+        size_ = size;
+        primary_index_ = primary_index;
+        blocks_.map(ptr, end);
+        if (blocks_.size() != (size / block_size + 1) * block_words)
+            throw std::runtime_error("corrupted index file");
+    }
+
+    /// @brief Occurence of c in the first n characters of a block
+    /// @param words Character words of the block
+    /// @param n Number of characters to count, less than block_size
+    /// @param c Rank of character
+    static INDEX rank(const uint64_t* words, std::size_t n, uint64_t c)
+    {
+        const uint64_t pattern = c * low_bits;
+        std::size_t full = n / per_word;
+        std::size_t rest = n % per_word;
+        std::size_t w = 0;
+        INDEX count = 0;
+
+#ifdef __AVX2__
+        w = full & ~std::size_t(3);
+        if (w)
+            count += rank_avx2(words, w, pattern);
+#endif
+        for (; w < full; w++)
+            count += popcount(match(words[w] ^ pattern));
+        if (rest)
+            count += popcount(match(words[full] ^ pattern)
+                            & ((uint64_t(1) << rest * BITS) - 1));
+        return count;
+    }
+
+  private:
+    /// @brief Given x = word ^ pattern, set the lowest bit of each
+    ///        field which is all zero (i.e. character equals c)
+    static uint64_t match(uint64_t x)
+    {
+        auto y = x;
+        for (int k = 1; k < BITS; k++)
+            y |= x >> k;
+        return ~y & low_bits;
+    }
+
+    static int popcount(uint64_t x)
+    {
+#ifdef __POPCNT__
+        return _mm_popcnt_u64(x);
+#else
+        return __builtin_popcountll(x);
+#endif
+    }
+
+#ifdef __AVX2__
+    /// @brief Same as the scalar loop in rank(), 4 words at a time.
+    ///        Popcount by nibble lookup (vpshufb), summed by vpsadbw.
+    /// @param n Number of words, multiple of 4
+    static INDEX rank_avx2(
+        const uint64_t* words
+      , std::size_t n
+      , uint64_t pattern
+    )
+    {
+        const __m256i pat    = _mm256_set1_epi64x(pattern);
+        const __m256i low    = _mm256_set1_epi64x(low_bits);
+        const __m256i nibble = _mm256_set1_epi8(0x0f);
+        const __m256i zero   = _mm256_setzero_si256();
+        const __m256i lookup = _mm256_setr_epi8(
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+          , 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+
+        __m256i sum = zero;
+        for (std::size_t w = 0; w < n; w += 4)
+        {
+            auto x = _mm256_xor_si256(pat, _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(words + w)));
+            auto y = x;
+            for (int k = 1; k < BITS; k++)
+                y = _mm256_or_si256(y, _mm256_srli_epi64(x, k));
+            auto m = _mm256_andnot_si256(y, low);
+
+            auto cnt = _mm256_add_epi8(
+                _mm256_shuffle_epi8(lookup, _mm256_and_si256(m, nibble))
+              , _mm256_shuffle_epi8(lookup, _mm256_and_si256(
+                    _mm256_srli_epi16(m, 4), nibble)));
+            sum = _mm256_add_epi64(sum, _mm256_sad_epu8(cnt, zero));
+        }
+        return _mm256_extract_epi64(sum, 0) + _mm256_extract_epi64(sum, 1)
+             + _mm256_extract_epi64(sum, 2) + _mm256_extract_epi64(sum, 3);
+    }
+#endif
+};
+
+template<typename INDEX, int BITS>
+constexpr uint32_t BlockOcc<INDEX, BITS>::type_id;
+template<typename INDEX, int BITS>
+constexpr int BlockOcc<INDEX, BITS>::alph_size;
+template<typename INDEX, int BITS>
+constexpr int BlockOcc<INDEX, BITS>::count_words;
+template<typename INDEX, int BITS>
+constexpr int BlockOcc<INDEX, BITS>::block_words;
+template<typename INDEX, int BITS>
+constexpr int BlockOcc<INDEX, BITS>::symbol_words;
+template<typename INDEX, int BITS>
+constexpr int BlockOcc<INDEX, BITS>::per_word;
+template<typename INDEX, int BITS>
+constexpr int BlockOcc<INDEX, BITS>::block_size;
@@ -0,0 +1,225 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+/// @brief Opt-in record of a construction: wall time, bytes of the
+///        arrays allocated and peak resident memory of every phase,
+///        plus counters such as LMS sizes. Recording is enabled for
+///        the calling thread by a BuildStats::Scope, the instrumented
+///        code records nothing (a thread local read per phase)
+///        otherwise, so no constructor takes an extra parameter.
+///
+///        BuildStats stats;
+///        {
+///            BuildStats::Scope scope(stats);
+///            FmIndex<...> fm_index(seq, ...);
+///        }
+///        stats.write_json(std::cout);
+class BuildStats
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Phase
+    {
+        std::string name;
+
+        /// @brief Number of enclosing phases, e.g. the SORTER stages
+        ///        are nested in the FmIndex "sorter" phase
+        int         depth;
+
+        /// @brief Recursion level of the sorter, -1 if not recursive
+        int         level;
+
+        /// @brief Start, in seconds since the stats were created
+        double      begin;
+        double      seconds = 0;
+
+        /// @brief Bytes of the arrays the phase allocates, 0 if not
+        ///        tracked
+        uint64_t    bytes;
+
+        /// @brief Peak resident set of the process at the end of the
+        ///        phase
+        uint64_t    peak_rss = 0;
+    };
+
+    struct Counter
+    {
+        std::string name;
+        double      value;
+    };
+
+    /// @brief Record to stats in this thread during the scope's life
+    class Scope
+    {
+        BuildStats* prev_;
+
+      public:
+        explicit Scope(BuildStats& stats)
+            : prev_(current())
+        {
+            current() = &stats;
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        ~Scope()
+        { current() = prev_; }
+    };
+
+    /// @brief Sequential phases of one routine, each ending when the
+    ///        next starts or the object goes out of scope
+    class Phases
+    {
+        static constexpr std::size_t none = std::size_t(-1);
+
+        BuildStats* stats_;
+        int         level_;
+        std::size_t open_ = none;
+
+      public:
+        /// @param level Recursion level of the routine, -1 for none
+        explicit Phases(int level = -1)
+            : stats_(current())
+            , level_(level)
+        {}
+
+        Phases(const Phases&) = delete;
+        Phases& operator=(const Phases&) = delete;
+
+        ~Phases()
+        { end(); }
+
+        /// @brief End the open phase and start another
+        /// @param bytes Bytes of the arrays the phase allocates
+        void next(const char* name, uint64_t bytes = 0)
+        {
+            end();
+            if (stats_)
+                open_ = stats_->begin_phase(name, level_, bytes);
+        }
+
+        void end()
+        {
+            if (open_ != none)
+                stats_->end_phase(open_);
+            open_ = none;
+        }
+    };
+
+    BuildStats()
+        : epoch_(Clock::now())
+    {}
+
+    /// @brief Whether this thread records
+    static bool enabled()
+    { return current() != nullptr; }
+
+    /// @brief Record a counter if this thread records
+    static void count(const std::string& name, double value)
+    {
+        if (auto stats = current())
+            stats->counters_.push_back({name, value});
+    }
+
+    /// @brief Phases in start order
+    const std::vector<Phase>& phases() const
+    { return phases_; }
+
+    const std::vector<Counter>& counters() const
+    { return counters_; }
+
+    /// @brief Sum of the phases' seconds with that name
+    double seconds(const std::string& name) const
+    {
+        double sum = 0;
+        for (const auto& phase : phases_)
+            if (phase.name == name)
+                sum += phase.seconds;
+        return sum;
+    }
+
+    /// @brief Write {"phases": [...], "counters": {...}}
+    void write_json(std::ostream& os) const
+    {
+        os << "{\n  \"phases\": [";
+        for (std::size_t i = 0; i < phases_.size(); i++)
+        {
+            const auto& phase = phases_[i];
+            os << (i ? "," : "") << "\n    {\"name\": ";
+            write_string(os, phase.name);
+            os << ", \"depth\": " << phase.depth;
+            if (phase.level >= 0)
+                os << ", \"level\": " << phase.level;
+            os << ", \"begin\": " << phase.begin
+               << ", \"seconds\": " << phase.seconds
+               << ", \"bytes\": " << phase.bytes
+               << ", \"peak_rss\": " << phase.peak_rss << "}";
+        }
+        os << "\n  ],\n  \"counters\": {";
+        for (std::size_t i = 0; i < counters_.size(); i++)
+        {
+            os << (i ? "," : "") << "\n    ";
+            write_string(os, counters_[i].name);
+            os << ": " << counters_[i].value;
+        }
+        os << "\n  }\n}\n";
+    }
+
+  private:
+    static BuildStats*& current()
+    {
+        static thread_local BuildStats* stats = nullptr;
+        return stats;
+    }
+
+    std::size_t begin_phase(const char* name, int level, uint64_t bytes)
+    {
+        phases_.push_back({name, depth_++, level, elapsed(), 0, bytes});
+        return phases_.size() - 1;
+    }
+
+    void end_phase(std::size_t i)
+    {
+        auto& phase = phases_[i];
+        phase.seconds = elapsed() - phase.begin;
+        phase.peak_rss = peak_rss();
+        depth_--;
+    }
+
+    double elapsed() const
+    {
+        return std::chrono::duration<double>(Clock::now() - epoch_).count();
+    }
+
+    /// @brief Peak resident set size in bytes (Linux reports KB)
+    static uint64_t peak_rss()
+    {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return uint64_t(usage.ru_maxrss) * 1024;
+    }
+
+    static void write_string(std::ostream& os, const std::string& s)
+    {
+        os << '"';
+        for (auto c : s)
+        {
+            if (c == '"' || c == '\\')
+                os << '\\';
+            os << c;
+        }
+        os << '"';
+    }
+
+    Clock::time_point    epoch_;
+    std::vector<Phase>   phases_;
+    std::vector<Counter> counters_;
+    int                  depth_ = 0;
+};
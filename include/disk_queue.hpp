@@ -0,0 +1,191 @@
+#pragma once
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <stdlib.h>
+#include <unistd.h>
+
+/// @brief Scratch space the suffix array of an index construction
+///        spills to. Only the suffix array goes to disk, the other
+///        construction arrays stay in memory (see FmIndex), so this
+///        lowers the peak of a construction but does not bound it.
+struct ExternalMemory
+{
+    /// @brief Directory of the scratch files, empty to build in
+    ///        memory
+    std::string scratch_dir;
+
+    /// @brief Bytes the suffix array may take in memory. A larger one
+    ///        is induced through scratch files whose buffers take at
+    ///        most this.
+    std::size_t sa_budget = std::size_t(1) << 30;
+
+    bool enabled() const
+    { return !scratch_dir.empty(); }
+};
+
+/// @brief FIFO queue kept in a scratch file. Only a write buffer and
+///        a read buffer of buffer_size elements each are in memory.
+///        Elements can be popped while the queue still grows, and the
+///        whole queue can be read again by rewind() or backward by
+///        for_each_reverse(). The file is unlinked on creation, so it
+///        goes away with the queue (or the process).
+template<typename T>
+class DiskQueue
+{
+    static_assert(std::is_trivially_copyable<T>::value
+                , "DiskQueue elements are copied as bytes");
+
+    int            fd_ = -1;
+    std::size_t    buffer_size_;
+    std::vector<T> write_buf_;
+    std::vector<T> read_buf_;
+
+    /// @brief Number of elements in the file
+    std::size_t    flushed_ = 0;
+
+    /// @brief Position of read_buf_[0] in the queue
+    std::size_t    read_begin_ = 0;
+
+    /// @brief Position of the next element to pop
+    std::size_t    head_ = 0;
+
+  public:
+    /// @param dir Directory to create the scratch file in
+    /// @param buffer_size Elements buffered for writing and reading
+    DiskQueue(const std::string& dir, std::size_t buffer_size)
+        : buffer_size_(std::max<std::size_t>(buffer_size, 1))
+    {
+        std::string path = dir + "/fm_index.XXXXXX";
+        std::vector<char> name(path.begin(), path.end());
+        name.push_back('\0');
+        fd_ = mkstemp(name.data());
+        if (fd_ < 0)
+            throw std::runtime_error("can not create scratch file in "
+                + dir + ": " + std::strerror(errno));
+        unlink(name.data());
+        write_buf_.reserve(buffer_size_);
+    }
+
+    DiskQueue(DiskQueue&& other) noexcept
+        : fd_(other.fd_)
+        , buffer_size_(other.buffer_size_)
+        , write_buf_(std::move(other.write_buf_))
+        , read_buf_(std::move(other.read_buf_))
+        , flushed_(other.flushed_)
+        , read_begin_(other.read_begin_)
+        , head_(other.head_)
+    {
+        other.fd_ = -1;
+    }
+
+    DiskQueue(const DiskQueue&) = delete;
+    DiskQueue& operator=(const DiskQueue&) = delete;
+
+    ~DiskQueue()
+    {
+        if (fd_ >= 0)
+            close(fd_);
+    }
+
+    std::size_t size() const
+    { return flushed_ + write_buf_.size(); }
+
+    void push(const T& value)
+    {
+        write_buf_.push_back(value);
+        if (write_buf_.size() == buffer_size_)
+        {
+            write(flushed_, write_buf_.data(), write_buf_.size());
+            flushed_ += write_buf_.size();
+            write_buf_.clear();
+        }
+    }
+
+    /// @brief Take the next element, including ones pushed after the
+    ///        reading started
+    /// @return false if every element pushed so far has been taken
+    bool pop(T& value)
+    {
+        if (head_ >= size())
+            return false;
+        if (head_ >= flushed_)
+            value = write_buf_[head_ - flushed_];
+        else
+        {
+            if (head_ < read_begin_
+             || head_ >= read_begin_ + read_buf_.size())
+                load(head_, std::min(buffer_size_, flushed_ - head_));
+            value = read_buf_[head_ - read_begin_];
+        }
+        head_++;
+        return true;
+    }
+
+    /// @brief Pop from the first element again
+    void rewind()
+    { head_ = 0; }
+
+    /// @brief Call f on every element from the last to the first, f
+    ///        must not push to this queue
+    template<class F>
+    void for_each_reverse(F f)
+    {
+        for (auto i = write_buf_.size(); i-- > 0; )
+            f(write_buf_[i]);
+        for (auto end = flushed_; end > 0; )
+        {
+            auto begin = end - std::min(end, buffer_size_);
+            load(begin, end - begin);
+            for (auto i = end; i-- > begin; )
+                f(read_buf_[i - begin]);
+            end = begin;
+        }
+    }
+
+  private:
+    void write(std::size_t pos, const T* data, std::size_t count)
+    {
+        auto ptr = reinterpret_cast<const char*>(data);
+        auto bytes = count * sizeof(T);
+        auto offset = static_cast<off_t>(pos * sizeof(T));
+        while (bytes > 0)
+        {
+            auto written = pwrite(fd_, ptr, bytes, offset);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                throw std::runtime_error(std::string(
+                    "can not write scratch file: ") + std::strerror(errno));
+            ptr += written;
+            bytes -= written;
+            offset += written;
+        }
+    }
+
+    void load(std::size_t pos, std::size_t count)
+    {
+        read_buf_.resize(count);
+        read_begin_ = pos;
+        auto ptr = reinterpret_cast<char*>(read_buf_.data());
+        auto bytes = count * sizeof(T);
+        auto offset = static_cast<off_t>(pos * sizeof(T));
+        while (bytes > 0)
+        {
+            auto got = pread(fd_, ptr, bytes, offset);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got <= 0)
+                throw std::runtime_error(std::string(
+                    "can not read scratch file: ") + std::strerror(errno));
+            ptr += got;
+            bytes -= got;
+            offset += got;
+        }
+    }
+};
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "fm_index.hpp"
+#include "saca_k.hpp"
+
+/// @brief DNA index written by build_index and read by fm_search and
+///        fm_server, 64-bit for sequences beyond 4G
+template<typename INDEX, typename INDEX_VECTOR = std::vector<INDEX>>
+using DnaFmIndex = FmIndex<
+    std::vector<char>, INDEX, 2, SACA_K, BlockOcc, DnaAlphabet
+  , INDEX_VECTOR>;
+
+/// @brief Map a DnaFmIndex file with the INDEX type its header records
+///        and call f(index), f being generic in the index type
+/// @param path Index file
+template<class F>
+void with_dna_fm_index(const std::string& path, F f)
+{
+    auto index_size = DnaFmIndex<uint32_t>::file_index_size(path);
+    if (index_size == sizeof(uint32_t))
+        f(DnaFmIndex<uint32_t>::load(path));
+    else if (index_size == sizeof(uint64_t))
+        f(DnaFmIndex<uint64_t>::load(path));
+    else
+        throw std::runtime_error("index type mismatch " + path);
+}
@@ -1,35 +1,70 @@
 #pragma once
+#include <array>
+#include <vector>
 #include <cassert>
 #include <cmath>
-#include <list>
 #include <fstream>
 #include <algorithm>
+#include <numeric>
 #include <functional>
-
+#include <memory>
+#include <string>
+#include <tuple>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include "mapped_array.hpp"
+#include "packed_vector.hpp"
+#include "sampled_occ.hpp"
+#include "block_occ.hpp"
+#include "wavelet_occ.hpp"
+#include "rank_bit_vector.hpp"
+#include "kmer_table.hpp"
+#include "alphabet.hpp"
+#include "thread_pool.hpp"
+#include "induce_buckets.hpp"
+#include "build_stats.hpp"
+#include "record_map.hpp"
+
+/// @tparam OCC Occ backend holding the bwt, BlockOcc (interleaved
+///         cache line blocks), SampledOcc (count samples every
+///         sample rate characters) or WaveletOcc (wavelet matrix,
+///         BITS ranks per occ, for large alphabets)
+/// @tparam SORTER Suffix sorter for the reduced problem, constructed
+///         from a thread count
+/// @tparam ALPHABET Map alphabet to their rank, RuntimeAlphabet
+///         (mapper given to constructor) or a stateless policy such
+///         as DnaAlphabet which is inlined
+/// @tparam INDEX_VECTOR Storage of the construction arrays (suffix
+///         array, LMS suffixes), std::vector<INDEX> or Int40Vector
+///         (with uint64_t INDEX) for texts beyond 4G at 5 bytes per
+///         entry
 template<
     typename SEQ
   , typename INDEX 
   , int BITS
   , template<typename, typename> typename SORTER
+  , template<typename, int> typename OCC = BlockOcc
+  , typename ALPHABET = RuntimeAlphabet<typename SEQ::value_type, INDEX>
+  , typename INDEX_VECTOR = std::vector<INDEX>
 >
 class FmIndex
 {
     using CharType     = typename SEQ::value_type;
     using CTableType   = std::array<INDEX
                           , static_cast<int>(std::pow(2, BITS))>;
-    using OccTableType = std::vector<CTableType>;
-    using LocTableType = std::vector<
-                            std::pair<INDEX, INDEX>>;
+    using OccType      = OCC<INDEX, BITS>;
+    using LocTableType = IntVector;
+    using KmerTableType = KmerTable<INDEX, BITS>;
     
-    /// @brief bwt of the orignal seq
-    SEQ               bwt_;
+    /// @brief bwt of the orignal seq and its occurence
+    OccType           occ_;
 
-    /// @brief Sampled mapping of index from bwt to original seq
+    /// @brief Location in the original seq of each marked bwt row, in
+    ///        row order (the j-th marked row's is the j-th element),
+    ///        packed in ceil(log2(seq size)) bits
     LocTableType      loc_table_;
 
-    /// @brief Sampled occurence of each alphabet in bwt
-    OccTableType      occ_table_ {{}}; 
-
     /// @brief Start position of each alphabet in first column
     CTableType        c_table_ {};
 
@@ -41,43 +76,126 @@ class FmIndex
     INDEX             sample_rate_;
 
     /// @brief Bit vector, set to 1 if i-th bwt's suffix array 
-    ///        location is stored.
-    std::vector<bool> bwt_marked_;
+    ///        location is stored. Its rank indexes loc_table_.
+    RankBitVector     bwt_marked_;
+
+    /// @brief Map alphabet to their rank
+    ALPHABET          map_;
+
+    /// @brief SA interval of every k-mer, skips the first k steps of
+    ///        a search (empty if built with kmer_len 0)
+    KmerTableType     kmer_table_;
+
+    /// @brief Record boundaries of a collection (one record, $
+    ///        excluded, if built from a single seq)
+    RecordMap         records_;
 
-    std::function<INDEX(CharType)> map_;
+    /// @brief Sorted rows of the suffixes starting at a record
+    ///        boundary: the begin of every non-empty record but the
+    ///        first, and $ (row 0)
+    MappedArray<uint64_t> record_rows_;
+
+    /// @brief Mapped index file backing the arrays above, null if the
+    ///        index is built in memory
+    std::shared_ptr<const MmapFile> file_;
+
+    /// @brief On-disk layout version, bump when layout changes
+    static constexpr uint32_t file_version_ = 7;
 
   public:
+    /// @brief Bwt interval [begin, end) of an approximate match and
+    ///        its number of errors
+    struct ApproxRange
+    {
+        INDEX    begin;
+        INDEX    end;
+        unsigned errors;
+    };
+
+    /// @brief Bwt interval of every character rank
+    using RangeTable   = std::array<std::pair<INDEX, INDEX>
+                          , static_cast<int>(std::pow(2, BITS))>;
+
     /// @brief Build fm-index using bwt-isfm alogrithm
     /// @param seq Sequence, required $(smalest alphabet) be 
     ///        inserted at the end
-    /// @param map Map alphabet to their rank
+    /// @param map Map alphabet to their rank, anything ALPHABET can
+    ///        be constructed from
     /// @param step Sample rate, valid value are 2^n, n>=0
-    template<class MAPPER>
-    FmIndex (const SEQ& seq, MAPPER map, INDEX step = 1)
-             : map_(map)
-             , sample_rate_(step)
+    /// @param threads Number of threads for the sorter, counting and
+    ///        occ, 0 for all hardware threads
+    /// @param kmer_len Build a k-mer interval table for this k (e.g.
+    ///        10-14 for DNA, table size is 2^(BITS*k)), 0 for none
+    /// @param external Scratch directory the suffix array spills to
+    ///        when it exceeds external.sa_budget. Only the suffix
+    ///        array streams through scratch files: seq, the type bits
+    ///        (1 bit per character), the reduced problem (two
+    ///        INDEX_VECTOR elements per LMS suffix, about n/3 of them
+    ///        for DNA), the short LMS hash table and the packed bwt
+    ///        (BITS per character) stay in memory, which is the peak
+    ///        of an external build.
+    /// @param occ_step Sample rate of an OCC sampling the bwt (e.g.
+    ///        SampledOcc), 2^n, 0 for step. Lets an index locating
+    ///        few rows sample locations sparsely and still get fast
+    ///        occ queries.
+    template<class MAPPER, class = std::enable_if_t<
+        std::is_constructible<ALPHABET, MAPPER>::value>>
+    FmIndex (const SEQ& seq, MAPPER map, INDEX step = 1
+           , unsigned threads = 1, unsigned kmer_len = 0
+           , const ExternalMemory& external = ExternalMemory()
+           , INDEX occ_step = 0)
+             : sample_rate_(step)
+             , map_(map)
     {
         assert(!(sample_rate_ & (sample_rate_-1)));
+        assert(!(occ_step & (occ_step-1)));
+        // positions are stored in INDEX_VECTOR, read back sign
+        // extended when narrower than INDEX
+        constexpr int value_bits = element_bits<INDEX_VECTOR>();
+        constexpr uint64_t max_size = (value_bits < 8 * sizeof(INDEX))
+            ? (uint64_t(1) << (value_bits - 1)) - 1
+            : std::numeric_limits<INDEX>::max();
+        if (seq.size() > max_size)
+            throw std::runtime_error("sequence too long for INDEX, size "
+                + std::to_string(seq.size()));
+        ThreadPool pool(threads);
+        BuildStats::Phases phases;
+        constexpr int index_bytes = element_bits<INDEX_VECTOR>() / 8;
 
         // Init member var and other param
         constexpr int alph_size = std::pow(2, BITS);
         constexpr int bit_mask  = alph_size - 1;
-        constexpr int short_lms_len = 12;
+        // LMS substr up to short_lms_len chars are hashed by their
+        // packed value, which takes at most 24 bits
+        constexpr int short_lms_len = 24 / BITS;
 
         // Scan through seq (right-to-left) to identify L/S type 
         // (S-type set to true)
+        phases.next("type", seq.size() / 8);
         std::vector<bool> type(seq.size());
         type[seq.size() - 1] = true; // $ is S-type
         type[seq.size() - 2] = false; 
         for (auto i = seq.size() - 3; ~i; i--)
-            if (seq[i] < seq[i+1] || 
-                (seq[i] == seq[i+1] && type[i+1]))
+            if (map_(seq[i]) < map_(seq[i+1]) || 
+                (map_(seq[i]) == map_(seq[i+1]) && type[i+1]))
                 type[i] = true;
 
         // Count the total number of each alphabet
         // $ is counted as the smallest alphabet
-        for (auto i = 0; i < seq.size(); i++)
-            c_table_[map_(seq[i])]++;
+        phases.next("count");
+        {
+            std::vector<CTableType> chunk_count(pool.size());
+            pool.parallel_for(seq.size(),
+                [this, &seq, &chunk_count](auto begin, auto end, auto tid)
+                {
+                    auto& count = chunk_count[tid];
+                    for (auto i = begin; i < end; i++)
+                        count[map_(seq[i])]++;
+                });
+            for (const auto& count : chunk_count)
+                for (std::size_t c = 0; c < c_table_.size(); c++)
+                    c_table_[c] += count[c];
+        }
         // Calculate accumulative sum
         INDEX sum = 0;
         for (auto& i : c_table_)
@@ -88,7 +206,7 @@ class FmIndex
         
         // Calculate number of LMS
         INDEX lms_size = 0;
-        for (auto i = 0; i < type.size(); i++)
+        for (INDEX i = 0; i < type.size(); i++)
             if (is_lms(i, type))
                 lms_size++;
 
@@ -96,12 +214,14 @@ class FmIndex
         // Produce shorten seq
         ///////////////////////
         constexpr int hash_size = std::pow(alph_size, short_lms_len);
+        phases.next("lms_extract"
+          , hash_size * sizeof(INDEX) + uint64_t(lms_size) * index_bytes);
         std::vector<INDEX> hash_table(hash_size); // for short LMS 
 
         // Scan through seq (right-to-left) to extract LMS,
         // only store distinct LMS (all long LMS and distinct short 
         // LMS)
-        std::vector<INDEX> lms(lms_size);
+        INDEX_VECTOR lms(lms_size);
         uint32_t key = 0;
         INDEX lms_len = 0;
         INDEX distinct_lms_size = 0;
@@ -111,7 +231,7 @@ class FmIndex
             // ex: ATGC -> ~(CGTA) = GCAT
             // TODO: this can be speed up if we can extract the
             // compressed LMS substr at once
-            uint32_t complement = ~map_(seq[i]) && bit_mask;
+            uint32_t complement = ~map_(seq[i]) & bit_mask;
             key = (key << BITS) + complement;
             lms_len++;
 
@@ -160,8 +280,9 @@ class FmIndex
         //           << std::endl;
 
         // Qsort distinct_LMS
-        std::vector<INDEX> lms_sa(lms_size);
-        for (auto i = 0; i < distinct_lms_size; i++)
+        phases.next("lms_sort", uint64_t(lms_size) * index_bytes);
+        INDEX_VECTOR lms_sa(lms_size);
+        for (INDEX i = 0; i < distinct_lms_size; i++)
             lms_sa[i] = i;
 
         // // debug: 1, 17, 30, 46, 57, 60, 72
@@ -176,13 +297,13 @@ class FmIndex
             // them
             [&seq, &type, &lms, this](auto a, auto b)
             {
-                auto a_pos = lms[a], b_pos = lms[b];
+                INDEX a_pos = lms[a], b_pos = lms[b];
 
                 // handle $
-                if (a_pos == seq.size()-1)
-                    return true;
-                else if (b_pos == seq.size()-1)
+                if (b_pos == seq.size()-1)
                     return false;
+                else if (a_pos == seq.size()-1)
+                    return true;
 
                 // compare first LMS char
                 if (map_(seq[a_pos]) < map_(seq[b_pos]))
@@ -206,7 +327,7 @@ class FmIndex
                     // if a reach LMS, b must reach LMS as well
                     // then they are equal
                     if (is_lms(a_pos, type))
-                        return true;
+                        return false;
 
                     a_pos++; b_pos++;
                 }
@@ -226,12 +347,13 @@ class FmIndex
 
         // Assign name to sorted distinct LMS
         // (TODO: use more space efficient index like char)
-        std::vector<INDEX> lms_name(distinct_lms_size);
+        phases.next("naming", 2 * uint64_t(distinct_lms_size) * index_bytes);
+        INDEX_VECTOR lms_name(distinct_lms_size);
         INDEX name = 0;
         auto sa_equal = 
             [&seq, &type, &lms, this](auto a, auto b)
             {
-                auto a_pos = lms[a], b_pos = lms[b];
+                INDEX a_pos = lms[a], b_pos = lms[b];
 
                 // handle $
                 if (a_pos == seq.size()-1 || b_pos == seq.size()-1)
@@ -245,7 +367,7 @@ class FmIndex
                 while (a_pos < seq.size()-1 && b_pos < seq.size()-1)
                 {
                     // compare char
-                    if (map_(seq[a_pos]) != map_(seq[b_pos]) &&
+                    if (map_(seq[a_pos]) != map_(seq[b_pos]) ||
                         type[a_pos] != type[b_pos])
                         return false;
 
@@ -260,7 +382,7 @@ class FmIndex
                 // either one of a or b reach $
                 return false;
             };
-        for (auto i = 0; i < distinct_lms_size; i++)
+        for (INDEX i = 0; i < distinct_lms_size; i++)
         {
             if (i != 0 && !sa_equal(lms_sa[i], lms_sa[i-1]))
                 name++;
@@ -275,8 +397,8 @@ class FmIndex
 
         // Place named lms back to order 
         // TODO: inplace reorder 
-        std::vector<INDEX> correct_order(distinct_lms_size);
-        for (auto i = 0; i < distinct_lms_size; i++)
+        INDEX_VECTOR correct_order(distinct_lms_size);
+        for (INDEX i = 0; i < distinct_lms_size; i++)
             correct_order[lms_sa[i]] = lms_name[i];
         // // debug: 2, 5, 2, 4, 3, 1, 0
         // std::cerr << "correct order: ";
@@ -291,13 +413,14 @@ class FmIndex
                 , j = distinct_lms_size-1
                 , k = lms_size-1; ~i; i--)
         {
-            uint32_t complement = ~map_(seq[i]) && bit_mask;
+            uint32_t complement = ~map_(seq[i]) & bit_mask;
             key = (key << BITS) + complement;
             lms_len++;
 
             if (is_lms(i, type))
             {
-                if (i == lms[j]) // distinct LMS
+                // distinct LMS (j wraps once all of them are seen)
+                if (j < distinct_lms_size && i == lms[j])
                 {
                     if (lms_len <= short_lms_len)
                         hash_table[key] = correct_order[j];
@@ -323,9 +446,17 @@ class FmIndex
         /////////////////////////////////////////
         // Produce LMS SA if name not yet unique
         /////////////////////////////////////////
+        BuildStats::count("seq_size", seq.size());
+        BuildStats::count("lms_size", lms_size);
+        BuildStats::count("distinct_lms_size", distinct_lms_size);
+        BuildStats::count("distinct_lms_ratio"
+          , double(distinct_lms_size) / lms_size);
+        BuildStats::count("lms_names", name + 1);
         if (lms_size != 1 && name < lms_size)
         {
-            SORTER<decltype(lms), decltype(lms_sa)> sa_builder;
+            phases.next("sorter");
+            SORTER<decltype(lms), decltype(lms_sa)> sa_builder(
+                pool.size());
             sa_builder.build(lms, lms_sa, name+1);
         }
         // // debug: 9, 8, 4, 0, 7, 5, 1, 3, 6, 2
@@ -338,11 +469,12 @@ class FmIndex
         // Transform SA1 to T's position
         //////////////////////////////////
         // Get all LMS
-        for (auto i = 0, j = 0; i < seq.size(); i++)
+        phases.next("lms_positions");
+        for (INDEX i = 0, j = 0; i < seq.size(); i++)
             if (is_lms(i, type))
                 lms[j++] = i; 
         // Transform SA1 to T's position
-        for (auto i = 0; i < lms_size; i++)
+        for (INDEX i = 0; i < lms_size; i++)
             lms_sa[i] = lms[lms_sa[i]];
         // // debug: 72, 60, 30, 1, 57, 43, 14, 19, 46, 17
         // std::cerr << "lms sa(after): ";
@@ -351,147 +483,950 @@ class FmIndex
         // std::cerr << std::endl;
 
 
+        // Only lms_sa is needed from here on
+        std::vector<bool>().swap(type);
+        INDEX_VECTOR().swap(lms);
+        std::vector<INDEX>().swap(hash_table);
+
         ///////////////
         // Induce sort
         ///////////////
-        std::vector<bool> pos_bit(seq.size());
+        // Sorted LMS suffixes of a bucket form a run of lms_sa
+        CTableType lms_count {};
+        for (INDEX i = 1; i < lms_size; i++)
+            lms_count[map_(seq[lms_sa[i]])]++;
+
+        // The suffix array is induced in memory unless it exceeds the
+        // budget of an external build, then the buckets stream
+        // through scratch files
+        uint64_t bwt_bytes = uint64_t(seq.size()) * BITS / 8;
+        PackedVector<BITS> bwt(seq.size());
+        assert(lms_sa[0] == seq.size() - 1);
+        if (external.enabled() &&
+            uint64_t(seq.size()) * index_bytes > external.sa_budget)
         {
-            std::vector<std::list<INDEX>> LMS(alph_size);
-            std::vector<std::list<INDEX>>   L(alph_size);
-            std::vector<std::list<INDEX>>  LS(alph_size);
-            std::vector<std::list<INDEX>>   S(alph_size);
-            CTableType head, tail;
-            bwt_.resize(seq.size());
-            bwt_marked_.resize(seq.size());
-
-            // init head, tail
-            for (auto i = 0; i < c_table_.size(); i++)
-            {
-                if (i == 0) // skip 0, it is for $
-                    head[i] = 1;
-                else
-                    head[i] = c_table_[i];
+            phases.next("induce", bwt_bytes + external.sa_budget);
+            DiskBuckets<INDEX, BITS, INDEX_VECTOR> buckets(
+                c_table_, seq.size(), std::move(lms_sa), lms_count
+              , external);
+            induce(seq, bwt, buckets);
+            phases.next("sample_locations");
+            sample_locations(buckets, seq.size(), pool);
+        }
+        else
+        {
+            phases.next("induce"
+              , bwt_bytes + uint64_t(seq.size()) * index_bytes);
+            MemoryBuckets<INDEX, BITS, INDEX_VECTOR> buckets(
+                c_table_, seq.size(), std::move(lms_sa), lms_count);
+            induce(seq, bwt, buckets);
+            phases.next("sample_locations");
+            sample_locations(buckets.sa(), pool);
+        }
 
-                if (i == c_table_.size() - 1)
-                    tail[i] = seq.size() - 1;
-                else 
-                    tail[i] = c_table_[i+1] - 1;
-            }
+        // Calculate occ
+        phases.next("occ");
+        occ_ = OccType(std::move(bwt), primary_index_
+                     , occ_step ? occ_step : sample_rate_, pool.size());
+
+        // Caculate c_table
+        for (std::size_t i = 0; i < c_table_.size(); i++)
+            c_table_[i] = occ_.occ(seq.size(), i);
+        sum = 1;
+        for (auto& i : c_table_)
+        {
+            std::swap(sum, i);
+            sum += i;
+        } 
+
+        phases.next("kmer_table");
+        kmer_table_ = KmerTableType(seq, map_, kmer_len, pool);
+        records_ = RecordMap(std::vector<uint64_t>{seq.size() - 1});
+        find_record_rows(pool);
+    }
+
+    /// @brief Build fm-index with a stateless alphabet policy
+    /// @param seq Sequence, required $(smalest alphabet) be 
+    ///        inserted at the end
+    /// @param step Sample rate, valid value are 2^n, n>=0
+    /// @param threads Number of threads, 0 for all hardware threads
+    /// @param kmer_len K of the k-mer interval table, 0 for none
+    /// @param external Scratch space, empty to build in memory
+    template<class A = ALPHABET, class = std::enable_if_t<
+        std::is_empty<A>::value>>
+    explicit FmIndex (const SEQ& seq, INDEX step = 1
+                    , unsigned threads = 1, unsigned kmer_len = 0
+                    , const ExternalMemory& external = ExternalMemory())
+        : FmIndex(seq, ALPHABET(), step, threads, kmer_len, external)
+    {}
+
+    /// @brief Build fm-index of a collection of sequences, which are
+    ///        concatenated and $ appended. Locations map to (record,
+    ///        offset) by to_record(), locate_records() and
+    ///        count_records() skip the matches crossing records.
+    /// @param records Sequences, without $
+    /// @param sentinel Character appended as $, one of rank 0
+    /// @param map Map alphabet to their rank
+    /// @param step Sample rate, valid value are 2^n, n>=0
+    /// @param threads Number of threads, 0 for all hardware threads
+    /// @param kmer_len K of the k-mer interval table, 0 for none
+    /// @param external Scratch space, empty to build in memory
+    template<class MAPPER, class = std::enable_if_t<
+        std::is_constructible<ALPHABET, MAPPER>::value>>
+    FmIndex (const std::vector<SEQ>& records, CharType sentinel
+           , MAPPER map, INDEX step = 1
+           , unsigned threads = 1, unsigned kmer_len = 0
+           , const ExternalMemory& external = ExternalMemory())
+        : FmIndex(concatenate(records, sentinel), map, step, threads
+                , kmer_len, external)
+    {
+        std::vector<uint64_t> lengths;
+        for (const auto& record : records)
+            lengths.push_back(record.size());
+        records_ = RecordMap(lengths);
+        ThreadPool pool(threads);
+        find_record_rows(pool);
+    }
+
+    /// @brief Build fm-index of a collection of sequences with a
+    ///        stateless alphabet policy, see above
+    template<class A = ALPHABET, class = std::enable_if_t<
+        std::is_empty<A>::value>>
+    FmIndex (const std::vector<SEQ>& records, CharType sentinel
+           , INDEX step = 1, unsigned threads = 1, unsigned kmer_len = 0
+           , const ExternalMemory& external = ExternalMemory())
+        : FmIndex(records, sentinel, ALPHABET(), step, threads, kmer_len
+                , external)
+    {}
+
+    /// @brief Map the i-th elemnet in bwt to the original seq
+    /// @param i i-th element in bwt
+    /// @return Location in the original seq
+    INDEX get_location(INDEX i) const
+    { 
+        INDEX step_count;
+        for (step_count = 0; !is_marked(i); step_count++)
+            i = lf(i, occ_[i]);
+
+        return loc_table_[bwt_marked_.rank(i)] + step_count;
+    }
+
+    /// @brief Map element in last column to first column 
+    /// @param i Last column index
+    /// @param c Character
+    /// @return First column index
+    INDEX lf_mapping(INDEX i, CharType c) const
+    { 
+        return lf(i, map_(c));
+    }
 
-            // Put sorted LMS to correspond character bucket
-            for (auto i = 0; i < lms_sa.size(); i++)
-                LMS[map_(seq[lms_sa[i]])].push_back(lms_sa[i]);
+    /// @brief Length of the indexed seq, $ included
+    INDEX size() const
+    {
+        return occ_.size();
+    }
 
-            std::ofstream ofs("temp_file");
-            // handle $ first
+    /// @brief Rank of character c in the alphabet
+    INDEX char_rank(CharType c) const
+    {
+        return map_(c);
+    }
+
+    /// @brief Extend the bwt interval of P to that of cP for every
+    ///        character c at once, the rows of a character's
+    ///        interval following those of smaller ones
+    /// @param range Bwt interval [first, second) of P
+    /// @param ranges Bwt interval of cP, indexed by the rank of c
+    /// @return Whether $P occurs as well (P is a prefix of seq), its
+    ///         row preceding all others
+    bool extend_all(std::pair<INDEX, INDEX> range, RangeTable& ranges) const
+    {
+        for (INDEX c = 0; c < ranges.size(); c++)
+            ranges[c] = std::make_pair(
+                lf(range.first, c), lf(range.second, c));
+        return range.first <= primary_index_
+            && primary_index_ < range.second;
+    }
+
+    /// @brief Find the suffix array interval of pattern by backward
+    ///        search. On a collection the interval also holds the
+    ///        matches crossing records, see locate_records().
+    /// @param pattern Pattern to be searched
+    /// @return Bwt index range [first, second) of suffixes prefixed
+    ///         by pattern, empty if pattern does not occur
+    template<class PATTERN>
+    std::pair<INDEX, INDEX> get_range(const PATTERN& pattern) const
+    {
+        INDEX begin, end;
+        auto remain = seed(pattern, begin, end);
+        while (remain != 0 && begin < end)
+        {
+            auto c = map_(pattern[--remain]);
+            begin = lf(begin, c);
+            end = lf(end, c);
+        }
+        return std::make_pair(begin, end);
+    }
+
+    /// @brief Count the occurence of pattern in the original seq. On
+    ///        a collection the matches crossing records are counted
+    ///        too, count_records() leaves them out.
+    /// @param pattern Pattern to be searched
+    /// @return Number of occurence
+    template<class PATTERN>
+    INDEX count(const PATTERN& pattern) const
+    {
+        auto range = get_range(pattern);
+        return range.second - range.first;
+    }
+
+    /// @brief Search the bwt interval of a batch of patterns. Up to
+    ///        window searches are in flight, each extended by one
+    ///        character per round. After a step the occ blocks of the
+    ///        search's next step are prefetched, and they are loaded
+    ///        while the other searches step, so their cache misses
+    ///        overlap instead of forming one chain per pattern.
+    /// @param patterns Random access container of patterns
+    /// @param window Number of searches in flight, enough to cover
+    ///        memory latency while their blocks stay in cache, 0 is
+    ///        taken as 1
+    /// @return Bwt interval [begin, end) of each pattern
+    template<class PATTERNS>
+    std::vector<std::pair<INDEX, INDEX>> get_range_batch(
+        const PATTERNS& patterns
+      , std::size_t window = 32
+    ) const
+    {
+        struct Search
+        {
+            std::size_t query;
+            std::size_t remain;
+            INDEX       begin;
+            INDEX       end;
+        };
+
+        window = std::max<std::size_t>(window, 1);
+        std::vector<std::pair<INDEX, INDEX>> ranges(patterns.size());
+        std::vector<Search> active;
+        active.reserve(window);
+        std::size_t next = 0;
+
+        while (true)
+        {
+            // fill the window with new searches
+            while (active.size() < window && next < patterns.size())
             {
-                auto idx = LMS[0].front();
-                LMS[0].pop_front();
-                induce_l(idx, seq, L, LS, head, pos_bit, ofs, false);
+                Search search {next++, 0, 0, 0};
+                search.remain = seed(
+                    patterns[search.query], search.begin, search.end);
+                if (search.remain == 0 || search.begin >= search.end)
+                    ranges[search.query] = 
+                        std::make_pair(search.begin, search.end);
+                else
+                {
+                    occ_.prefetch(search.begin);
+                    occ_.prefetch(search.end);
+                    active.push_back(search);
+                }
             }
+            if (active.empty())
+                break;
 
-            // Left-to-right scan
-            for (auto i = 0; i < alph_size; i++)
+            for (std::size_t j = 0; j < active.size(); )
             {
-                while (!L[i].empty())
+                auto& search = active[j];
+                auto c = map_(patterns[search.query][--search.remain]);
+                search.begin = lf(search.begin, c);
+                search.end = lf(search.end, c);
+
+                // retire finished search by swapping in the last one
+                if (search.remain == 0 || search.begin >= search.end)
                 {
-                    auto idx = L[i].front();
-                    L[i].pop_front();
-                    induce_l(idx, seq, L, LS, head, pos_bit, ofs, true);
-        // TODO: fix double free bug here, with input seq=AAAAAAAAAA
-        // std::cerr << "po\n";//debug
+                    ranges[search.query] = 
+                        std::make_pair(search.begin, search.end);
+                    search = active.back();
+                    active.pop_back();
                 }
-        // std::cerr << "hi\n";//debug
-                while (!LMS[i].empty())
+                else
                 {
-                    auto idx = LMS[i].front();
-                    LMS[i].pop_front();
-                    induce_l(idx, seq, L, LS, head, pos_bit, ofs, false);
+                    occ_.prefetch(search.begin);
+                    occ_.prefetch(search.end);
+                    j++;
                 }
             }
+        }
+        return ranges;
+    }
+
+    /// @brief Count the occurence of a batch of patterns, see
+    ///        get_range_batch()
+    /// @param patterns Random access container of patterns
+    /// @param window Number of searches in flight
+    /// @return Number of occurence of each pattern
+    template<class PATTERNS>
+    std::vector<INDEX> count_batch(
+        const PATTERNS& patterns
+      , std::size_t window = 32
+    ) const
+    {
+        auto ranges = get_range_batch(patterns, window);
+        std::vector<INDEX> counts(ranges.size());
+        for (std::size_t i = 0; i < ranges.size(); i++)
+            counts[i] = ranges[i].second - ranges[i].first;
+        return counts;
+    }
+
+    /// @brief Locate all occurence of pattern in the original seq,
+    ///        see resolve()
+    /// @param pattern Pattern to be searched
+    /// @return Location of each occurence, in bwt (suffix array) order
+    template<class PATTERN>
+    std::vector<INDEX> locate(const PATTERN& pattern) const
+    {
+        return locate_range(get_range(pattern));
+    }
 
-            // Right-to-left scan
-            for (auto i = alph_size-1; ~i; i--)
+    /// @brief Locate the rows of a bwt interval, see resolve()
+    /// @param range Bwt interval [first, second)
+    /// @return Location of each row, in row order
+    std::vector<INDEX> locate_range(std::pair<INDEX, INDEX> range) const
+    {
+        std::vector<INDEX> locations;
+        locations.reserve(range.second - range.first);
+        resolve(range, [&locations](INDEX location)
+            { locations.push_back(location); });
+        return locations;
+    }
+
+    /// @brief Number of records, 1 unless built from a collection
+    std::size_t record_count() const
+    { return records_.count(); }
+
+    /// @brief Map a location to its record and the offset in it
+    /// @param location Location in the concatenated seq, $ excluded
+    std::pair<std::size_t, INDEX> to_record(INDEX location) const
+    {
+        auto record = records_.to_record(location);
+        return std::make_pair(record.first, INDEX(record.second));
+    }
+
+    /// @brief Length of a record, $ excluded
+    INDEX record_length(std::size_t record) const
+    { return records_.length(record); }
+
+    /// @brief Locate all occurence of pattern within the records.
+    ///        Each location is checked against the record boundaries
+    ///        as it is resolved, matches crossing the end of a record
+    ///        (or reaching $) are dropped.
+    /// @param pattern Pattern to be searched
+    /// @return (record, offset) of each occurence, in bwt order
+    template<class PATTERN>
+    std::vector<std::pair<std::size_t, INDEX>> locate_records(
+        const PATTERN& pattern) const
+    {
+        std::vector<std::pair<std::size_t, INDEX>> hits;
+        resolve(get_range(pattern), [this, &hits, &pattern](INDEX location)
             {
-                while (!S[i].empty())
+                std::size_t record;
+                uint64_t offset;
+                if (records_.locate(location, pattern.size()
+                                  , record, offset))
+                    hits.emplace_back(record, offset);
+            });
+        return hits;
+    }
+
+    /// @brief Count the occurence of pattern within the records, i.e.
+    ///        the hits of locate_records(), by a backward search that
+    ///        drops the crossing matches as it goes. Once the search
+    ///        has matched a suffix of the pattern, the rows of its
+    ///        interval starting at a record boundary are the matches
+    ///        that would continue into the previous record. Each is
+    ///        followed back over the rest of the pattern (stopping at
+    ///        the first mismatch) and, if it matches, left out of the
+    ///        count; a match over several boundaries is left out at
+    ///        its first one. The cost is that of a count() without the
+    ///        k-mer table plus a few LF steps per boundary row met,
+    ///        no location is resolved.
+    /// @param pattern Pattern to be searched
+    /// @return Number of occurence not crossing records
+    template<class PATTERN>
+    INDEX count_records(const PATTERN& pattern) const
+    {
+        if (pattern.size() == 0)
+            return records_.size();
+
+        INDEX begin = 0, end = occ_.size(), crossing = 0;
+        for (auto remain = pattern.size(); remain != 0 && begin < end; )
+        {
+            auto c = map_(pattern[--remain]);
+            begin = lf(begin, c);
+            end = lf(end, c);
+            if (remain == 0)
+                break;
+
+            auto first = std::lower_bound(
+                record_rows_.begin(), record_rows_.end(), begin);
+            auto last = std::lower_bound(first, record_rows_.end(), end);
+            for (auto row = first; row != last; row++)
+                if (continues(*row, pattern, remain))
+                    crossing++;
+        }
+        return (begin < end) ? end - begin - crossing : 0;
+    }
+
+    /// @brief Find the strings within k mismatches of pattern by a
+    ///        backtracking backward search. All characters are
+    ///        extended at once per step, and a branch is pruned as soon
+    ///        as its mismatches plus a lower bound of those of the
+    ///        pattern prefix left (see error_bounds()) exceed k.
+    /// @param pattern Pattern to be searched
+    /// @param k Maximum number of mismatches, meant for small k
+    /// @return Bwt interval of each matched string with its number of
+    ///         mismatches, sorted by interval
+    template<class PATTERN>
+    std::vector<ApproxRange> search_mismatch(
+        const PATTERN& pattern
+      , unsigned k
+    ) const
+    {
+        return approx_search(pattern, k, false);
+    }
+
+    /// @brief Find the strings within edit distance k of pattern, see
+    ///        search_mismatch(). Besides (mis)matches, a step skips a
+    ///        pattern character (insertion) or a text one (deletion),
+    ///        an insertion never directly following a deletion or the
+    ///        other way round, and no deletion at the pattern ends.
+    /// @return Bwt interval of each matched string with its smallest
+    ///         edit distance, sorted by interval
+    template<class PATTERN>
+    std::vector<ApproxRange> search_edit(
+        const PATTERN& pattern
+      , unsigned k
+    ) const
+    {
+        return approx_search(pattern, k, true);
+    }
+
+    /// @brief Save index to file. The file can be mapped back by
+    ///        load() and queried in place.
+    /// @param path Output file
+    void save(const std::string& path) const
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        if (!ofs)
+            throw std::runtime_error("can not open " + path);
+
+        FileHeader header {};
+        std::memcpy(header.magic, file_magic(), sizeof(header.magic));
+        header.version       = file_version_;
+        header.index_size    = sizeof(INDEX);
+        header.bits          = BITS;
+        header.occ_type      = OccType::type_id;
+        header.primary_index = primary_index_;
+        header.sample_rate   = sample_rate_;
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(&c_table_)
+                , sizeof(c_table_));
+        static const char pad[8] {};
+        ofs.write(pad, MappedArray<char>::padding(sizeof(c_table_)));
+
+        occ_.save(ofs);
+        loc_table_.save(ofs);
+        bwt_marked_.save(ofs);
+        kmer_table_.save(ofs);
+        records_.save(ofs);
+        record_rows_.save(ofs);
+
+        if (!ofs)
+            throw std::runtime_error("can not write " + path);
+    }
+
+    /// @brief Map an index file written by save(), see load(path).
+    /// @param path Index file
+    /// @param map Map alphabet to their rank, must be the one used to
+    ///        build the index
+    template<class MAPPER>
+    static FmIndex load(const std::string& path, MAPPER map)
+    {
+        auto index = load(path);
+        index.map_ = ALPHABET(map);
+        return index;
+    }
+
+    /// @brief Map an index file written by save(). Nothing is copied,
+    ///        queries read the page-cached file directly, so several
+    ///        processes can share one index. A runtime mapper must be
+    ///        provided by load(path, map).
+    /// @param path Index file
+    static FmIndex load(const std::string& path)
+    {
+        FmIndex index;
+        index.file_ = std::make_shared<const MmapFile>(path);
+
+        auto ptr = index.file_->data();
+        auto end = ptr + index.file_->size();
+        FileHeader header;
+        if (index.file_->size() < sizeof(header) + sizeof(c_table_))
+            throw std::runtime_error("truncated index file " + path);
+        std::memcpy(&header, ptr, sizeof(header));
+        ptr += sizeof(header);
+
+        check_header(header, path);
+        if (header.index_size != sizeof(INDEX) ||
+            header.bits != BITS ||
+            header.occ_type != OccType::type_id)
+            throw std::runtime_error(
+                "index type mismatch " + path);
+
+        index.primary_index_ = header.primary_index;
+        index.sample_rate_   = header.sample_rate;
+        std::memcpy(&index.c_table_, ptr, sizeof(c_table_));
+        ptr += sizeof(c_table_)
+             + MappedArray<char>::padding(sizeof(c_table_));
+
+        index.occ_.map(ptr, end);
+        index.loc_table_.map(ptr, end);
+        index.bwt_marked_.map(ptr, end);
+        index.kmer_table_.map(ptr, end);
+        index.records_.map(ptr, end);
+        index.record_rows_.map(ptr, end);
+        if (index.record_rows_.empty())
+            throw std::runtime_error("corrupted index file");
+        return index;
+    }
+
+    /// @brief Size in bytes of the INDEX type of an index file written
+    ///        by save(), to pick the instance loading it
+    /// @param path Index file
+    static uint32_t file_index_size(const std::string& path)
+    {
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs)
+            throw std::runtime_error("can not open " + path);
+        FileHeader header;
+        if (!ifs.read(reinterpret_cast<char*>(&header), sizeof(header)))
+            throw std::runtime_error("truncated index file " + path);
+        check_header(header, path);
+        return header.index_size;
+    }
+
+  private:
+    /// @brief Last step of an edit distance search branch
+    enum class EditOp { match, insertion, deletion };
+
+    /// @brief State shared by the branches of an approximate search
+    struct ApproxSearch
+    {
+        std::vector<INDEX>        ranks;
+        std::vector<unsigned>     bounds;
+        unsigned                  k;
+        bool                      edit;
+        std::vector<ApproxRange>  hits;
+    };
+
+    template<class PATTERN>
+    std::vector<ApproxRange> approx_search(
+        const PATTERN& pattern
+      , unsigned k
+      , bool edit
+    ) const
+    {
+        ApproxSearch search {{}, {}, k, edit, {}};
+        for (std::size_t i = 0; i < pattern.size(); i++)
+            search.ranks.push_back(map_(pattern[i]));
+        search.bounds = error_bounds(search.ranks);
+        if (search.bounds.back() <= k)
+            backtrack(search, search.ranks.size(), 0, occ_.size(), 0
+                    , EditOp::match);
+
+        // edit branches can reach a string more than once
+        auto& hits = search.hits;
+        std::sort(hits.begin(), hits.end(),
+            [](const ApproxRange& a, const ApproxRange& b)
+            {
+                return std::tie(a.begin, a.end, a.errors)
+                     < std::tie(b.begin, b.end, b.errors);
+            });
+        hits.erase(std::unique(hits.begin(), hits.end(),
+            [](const ApproxRange& a, const ApproxRange& b)
+            { return a.begin == b.begin && a.end == b.end; })
+          , hits.end());
+        return hits;
+    }
+
+    /// @brief Lower bound of the errors of every pattern prefix. The
+    ///        pattern is cut from the right into segments that do not
+    ///        occur in seq (by one backward search restarted after
+    ///        each), every alignment has an error in each of them, so
+    ///        the segments within a prefix bound its errors.
+    /// @param ranks Pattern as character ranks
+    /// @return Bound of prefix [0, i) at i, for i in [0, size]
+    std::vector<unsigned> error_bounds(const std::vector<INDEX>& ranks) const
+    {
+        std::vector<unsigned> bounds(ranks.size() + 1, 0);
+        INDEX begin = 0, end = occ_.size();
+        auto segment_end = ranks.size();
+        for (auto i = ranks.size(); i-- > 0; )
+        {
+            begin = lf(begin, ranks[i]);
+            end = lf(end, ranks[i]);
+            if (begin >= end)
+            {
+                // [i, segment_end) does not occur, counted by the
+                // prefixes containing it, the next segment ends at i
+                bounds[segment_end]++;
+                segment_end = i;
+                begin = 0;
+                end = occ_.size();
+            }
+        }
+        std::partial_sum(bounds.begin(), bounds.end(), bounds.begin());
+        return bounds;
+    }
+
+    /// @brief Extend the match of pattern [i, size) in bwt interval
+    ///        [begin, end) with errors so far
+    void backtrack(
+        ApproxSearch& search
+      , std::size_t i
+      , INDEX begin
+      , INDEX end
+      , unsigned errors
+      , EditOp last
+    ) const
+    {
+        if (i == 0)
+        {
+            search.hits.push_back({begin, end, errors});
+            return;
+        }
+        const auto& bounds = search.bounds;
+        auto k = search.k;
+
+        // no error left, match the rest of the prefix exactly
+        if (errors + 1 + bounds[i-1] > k)
+        {
+            for (; i > 0 && begin < end; i--)
+            {
+                begin = lf(begin, search.ranks[i-1]);
+                end = lf(end, search.ranks[i-1]);
+            }
+            if (begin < end)
+                search.hits.push_back({begin, end, errors});
+            return;
+        }
+
+        if (search.edit && last != EditOp::deletion)
+            backtrack(search, i - 1, begin, end, errors + 1
+                    , EditOp::insertion);
+
+        RangeTable ranges;
+        extend_all(std::make_pair(begin, end), ranges);
+        for (INDEX c = 0; c < ranges.size(); c++)
+        {
+            if (ranges[c].first >= ranges[c].second)
+                continue;
+            auto e = errors + (c != search.ranks[i-1]);
+            if (e + bounds[i-1] <= k)
+                backtrack(search, i - 1, ranges[c].first
+                        , ranges[c].second, e, EditOp::match);
+            if (search.edit && last != EditOp::insertion
+             && i < search.ranks.size() && errors + 1 + bounds[i] <= k)
+                backtrack(search, i, ranges[c].first, ranges[c].second
+                        , errors + 1, EditOp::deletion);
+        }
+    }
+
+    /// @brief Concatenate records and append $
+    static SEQ concatenate(const std::vector<SEQ>& records
+                         , CharType sentinel)
+    {
+        std::size_t size = 1;
+        for (const auto& record : records)
+            size += record.size();
+        SEQ seq;
+        seq.reserve(size);
+        for (const auto& record : records)
+            seq.insert(seq.end(), record.begin(), record.end());
+        seq.push_back(sentinel);
+        return seq;
+    }
+
+    /// @brief Call f on the location of every row in range, in row
+    ///        order. Rows are lf-mapped together until each reaches a
+    ///        marked row, whose location is read from loc_table_ at
+    ///        its rank.
+    template<class F>
+    void resolve(std::pair<INDEX, INDEX> range, F f) const
+    {
+        std::size_t hits = range.second - range.first;
+        std::vector<INDEX> rows(hits), steps(hits, 0);
+        std::iota(rows.begin(), rows.end(), range.first);
+
+        // Interleave lf steps of all unresolved rows
+        std::vector<std::size_t> active(hits);
+        std::iota(active.begin(), active.end(), 0);
+        while (!active.empty())
+        {
+            for (std::size_t j = 0; j < active.size(); )
+            {
+                auto q = active[j];
+                if (is_marked(rows[q]))
                 {
-                    auto idx = S[i].back();
-                    S[i].pop_back();
-                    induce_s(idx, seq, S, tail, pos_bit, ofs);
+                    active[j] = active.back();
+                    active.pop_back();
                 }
-                while (!LS[i].empty()) 
+                else
                 {
-                    auto idx = LS[i].back();
-                    LS[i].pop_back();
-                    induce_s(idx, seq, S, tail, pos_bit, ofs);
+                    rows[q] = lf(rows[q], occ_[rows[q]]);
+                    steps[q]++;
+                    occ_.prefetch(rows[q]);
+                    bwt_marked_.prefetch(rows[q]);
+                    j++;
                 }
             }
-            ofs.close();
         }
 
-        // // Get location table from file
-        // std::ifstream ifs("temp_file");
-        // while (!ifs.eof())
-        // {
-        //     INDEX bwt_pos, sa_pos;
-        //     ifs >> bwt_pos >> sa_pos;
-        //     std::cerr << (int)bwt_pos << " " << (int)sa_pos << std::endl;
-        //     loc_table[bwt_pos / sample_rate_] = std::make_pair(bwt_pos, sa_pos);
-        // }
-        // ifs.close();
-
-        // sort location_table
-        std::sort(loc_table_.begin(), loc_table_.end(), 
-            [](const auto& lhs, const auto& rhs)
-            { return lhs.first < rhs.first; });
+        for (std::size_t q = 0; q < hits; q++)
+            f(loc_table_[bwt_marked_.rank(rows[q])] + steps[q]);
+    }
 
-        // Calculate occ
-        for (auto& i : c_table_)
-            i = 0;
-        for (auto i = 0; i < bwt_.size(); i++)
+    /// @brief Leading block of the index file
+    struct FileHeader
+    {
+        char     magic[8];
+        uint32_t version;
+        uint32_t index_size;
+        uint32_t bits;
+        uint32_t occ_type;
+        uint64_t primary_index;
+        uint64_t sample_rate;
+    };
+
+    static const char* file_magic() { return "FMINDEX"; }
+
+    /// @brief Throw unless header is of an index file of this version
+    static void check_header(const FileHeader& header
+                           , const std::string& path)
+    {
+        if (std::memcmp(header.magic, file_magic()
+                      , sizeof(header.magic)) != 0)
+            throw std::runtime_error("not an index file " + path);
+        if (header.version != file_version_)
+            throw std::runtime_error(
+                "unsupported index version "
+              + std::to_string(header.version));
+    }
+
+    /// @brief Only used by load()
+    FmIndex() = default;
+
+    /// @brief Start a backward search, from the k-mer table
+    ///        interval of the pattern's last k characters if possible
+    /// @param begin,end Initial interval
+    /// @return Number of characters left to search
+    template<class PATTERN>
+    std::size_t seed(
+        const PATTERN& pattern
+      , INDEX& begin
+      , INDEX& end
+    ) const
+    {
+        std::size_t remain = pattern.size();
+        auto k = kmer_table_.k();
+        if (k == 0 || remain < k)
         {
-            if (i != primary_index_)
-                c_table_[map_(bwt_[i])]++;
-            if ((i+1 & (sample_rate_ - 1)) == 0)
-                occ_table_.emplace_back(c_table_);
+            begin = 0;
+            end = occ_.size();
+            return remain;
         }
 
-        // Caculate c_table
-        sum = 1;
-        for (auto& i : c_table_)
+        uint64_t code = 0;
+        for (auto i = remain - k; i < remain; i++)
+            code = kmer_table_.push(code, map_(pattern[i]));
+        std::tie(begin, end) = kmer_table_.range(code);
+        return remain - k;
+    }
+
+    /// @brief Whether the suffix of row, which starts at a record
+    ///        boundary, is preceded by pattern[0, len) with no other
+    ///        boundary in between, see count_records()
+    template<class PATTERN>
+    bool continues(INDEX row, const PATTERN& pattern, std::size_t len) const
+    {
+        while (len != 0)
         {
-            std::swap(sum, i);
-            sum += i;
-        } 
+            if (row == primary_index_)
+                return false;
+            INDEX c = occ_[row];
+            if (c != map_(pattern[--len]))
+                return false;
+            row = lf(row, c);
+            if (len != 0 && std::binary_search(
+                    record_rows_.begin(), record_rows_.end(), row))
+                return false;
+        }
+        return true;
     }
 
-    /// @brief Map the i-th elemnet in bwt to the original seq
-    /// @param i i-th element in bwt
-    /// @return Location in the original seq
-    INDEX get_location(INDEX i) const
-    { 
-        INDEX step_count;
-        for (step_count = 0; !bwt_marked_[i]; step_count++)
-            i = lf_mapping(i, bwt_[i]);
+    /// @brief Fill record_rows_ from records_ and the sampled
+    ///        locations. The row of a boundary is that of the next
+    ///        sampled location (or $) followed back by LF, fewer than
+    ///        sample rate steps, so only the location samples are
+    ///        scanned.
+    void find_record_rows(ThreadPool& pool)
+    {
+        uint64_t n = occ_.size();
+        std::vector<uint64_t> boundaries;
+        uint64_t offset = 0;
+        for (std::size_t r = 0; r < records_.count(); r++)
+        {
+            auto length = records_.length(r);
+            if (length != 0 && offset != 0)
+                boundaries.push_back(offset);
+            offset += length;
+        }
+
+        // next sampled location of each boundary, $ if none
+        std::vector<uint64_t> samples;
+        for (auto b : boundaries)
+        {
+            auto s = (b + sample_rate_ - 1) & ~uint64_t(sample_rate_ - 1);
+            if (s < n - 1)
+                samples.push_back(s);
+        }
+        std::sort(samples.begin(), samples.end());
+        samples.erase(std::unique(samples.begin(), samples.end())
+                    , samples.end());
+
+        // rank of the row of each sample among the marked rows
+        std::vector<uint64_t> ranks(samples.size());
+        if (!samples.empty())
+            pool.parallel_for(loc_table_.size(),
+                [this, &samples, &ranks](auto begin, auto end, auto)
+                {
+                    for (auto j = begin; j < end; j++)
+                    {
+                        uint64_t location = loc_table_[j];
+                        auto it = std::lower_bound(
+                            samples.begin(), samples.end(), location);
+                        if (it != samples.end() && *it == location)
+                            ranks[it - samples.begin()] = j;
+                    }
+                });
+
+        record_rows_.clear();
+        record_rows_.emplace_back(0);
+        for (auto b : boundaries)
+        {
+            auto it = std::lower_bound(samples.begin(), samples.end(), b);
+            uint64_t location = n - 1, row = 0;
+            if (it != samples.end() && *it - b < sample_rate_)
+            {
+                location = *it;
+                row = marked_row(ranks[it - samples.begin()]);
+            }
+            for (; location != b; location--)
+                row = lf(row, occ_[row]);
+            record_rows_.emplace_back(row);
+        }
+        std::sort(record_rows_.begin(), record_rows_.end());
+    }
+
+    /// @brief Row of the j-th marked row, by a binary search on rank
+    INDEX marked_row(uint64_t j) const
+    {
+        INDEX lo = 0, hi = occ_.size() - 1;
+        while (lo < hi)
+        {
+            auto mid = lo + (hi - lo) / 2;
+            if (bwt_marked_.rank(mid + 1) <= j)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
 
-        auto itr = std::lower_bound(
-            loc_table_.begin(), loc_table_.end(), i,
-            [](const std::pair<INDEX, INDEX>& lhs, INDEX rhs)
-            { return lhs.first < rhs; });
+    bool is_marked(INDEX i) const
+    {
+        return bwt_marked_[i];
+    }
+
+    /// @brief Mark rows whose location is a multiple of sample rate
+    ///        and store their locations in row order
+    /// @param sa Suffix array
+    void sample_locations(const INDEX_VECTOR& sa, ThreadPool& pool)
+    {
+        auto sampled = [this, &sa](std::size_t row)
+        { return (sa[row] & (sample_rate_ - 1)) == 0; };
+
+        // chunks of whole blocks, so threads set disjoint words
+        bwt_marked_ = RankBitVector(sa.size());
+        pool.parallel_for(sa.size(),
+            [this, &sampled](auto begin, auto end, auto)
+            {
+                for (auto row = begin; row < end; row++)
+                    if (sampled(row))
+                        bwt_marked_.set(row);
+            }, RankBitVector::block_bits);
+        bwt_marked_.init_rank();
+
+        std::vector<INDEX> locations(bwt_marked_.rank(sa.size()));
+        pool.parallel_for(sa.size(),
+            [this, &sa, &sampled, &locations](auto begin, auto end, auto)
+            {
+                auto j = bwt_marked_.rank(begin);
+                for (auto row = begin; row < end; row++)
+                    if (sampled(row))
+                        locations[j++] = sa[row];
+            });
 
-        return itr->second + step_count;
+        store_locations(locations, sa.size(), pool);
     }
 
-    /// @brief Map element in last column to first column 
-    /// @param i Last column index
-    /// @param c Character
-    /// @return First column index
-    INDEX lf_mapping(INDEX i, CharType c) const
-    { 
-        return c_table_[map_(c)] + get_occ(i, c);
+    /// @brief Same as above for a suffix array streamed in row order
+    ///        from a bucket store
+    template<class BUCKETS>
+    void sample_locations(BUCKETS& buckets, INDEX n, ThreadPool& pool)
+    {
+        bwt_marked_ = RankBitVector(n);
+        std::vector<INDEX> locations;
+        INDEX row = 0;
+        buckets.for_each_row([this, &locations, &row](INDEX idx)
+            {
+                if ((idx & (sample_rate_ - 1)) == 0)
+                {
+                    bwt_marked_.set(row);
+                    locations.push_back(idx);
+                }
+                row++;
+            });
+        assert(row == n);
+        bwt_marked_.init_rank();
+        store_locations(locations, n, pool);
     }
-    
-  private:
+
+    /// @brief Pack sampled locations into loc_table_
+    void store_locations(
+        const std::vector<INDEX>& locations
+      , INDEX n
+      , ThreadPool& pool
+    )
+    {
+        // chunks of 64 elements, so threads set disjoint words
+        loc_table_ = LocTableType(
+            locations.size(), IntVector::bit_width(n - 1));
+        pool.parallel_for(locations.size(),
+            [this, &locations](auto begin, auto end, auto)
+            {
+                for (auto j = begin; j < end; j++)
+                    loc_table_.set(j, locations[j]);
+            }, 64);
+    }
+
     bool is_lms(INDEX i, const std::vector<bool>& type) const
     {
         // type[0]'s previous is $, so it can not be LMS
@@ -501,121 +1436,108 @@ class FmIndex
             return false;
     }
 
+    /// @brief Induce all suffixes from the sorted LMS ones
+    /// @param buckets Bucket store holding the sorted LMS suffixes,
+    ///        see induce_buckets.hpp
+    template<class BUCKETS>
+    void induce(const SEQ& seq, PackedVector<BITS>& bwt, BUCKETS& buckets)
+    {
+        constexpr INDEX alph_size = std::pow(2, BITS);
+
+        // $ is the first row
+        bwt.set(0, map_(seq[seq.size() - 2]));
+        induce_l(seq.size() - 1, seq, bwt, buckets);
+
+        // Left-to-right scan, sorted LMS of a bucket follow its
+        // L-type suffixes
+        for (INDEX c = 0; c < alph_size; c++)
+        {
+            buckets.for_each_l(c, [&](INDEX idx)
+                { induce_l(idx, seq, bwt, buckets); });
+            buckets.for_each_lms(c, [&](INDEX idx)
+                { induce_l(idx, seq, bwt, buckets); });
+        }
+
+        // Right-to-left scan, S-type part of a bucket first, then
+        // its L-type part
+        for (INDEX c = alph_size; c-- > 0; )
+        {
+            buckets.for_each_s(c, [&](INDEX idx)
+                { induce_s(idx, true, seq, bwt, buckets); });
+            buckets.for_each_l_reverse(c, [&](INDEX idx)
+                { induce_s(idx, false, seq, bwt, buckets); });
+        }
+    }
+
+    /// @brief Place the L-type suffix preceding suffix idx (if any)
+    ///        at the head of its bucket
+    template<class BUCKETS>
     void induce_l(
         INDEX idx
       , const SEQ& seq
-      , std::vector<std::list<INDEX>>& L
-      , std::vector<std::list<INDEX>>& LS
-      , CTableType& head
-      , std::vector<bool>& pos_bit
-      , std::ofstream& ofs
-      , bool is_l_queue
+      , PackedVector<BITS>& bwt
+      , BUCKETS& buckets
     )
     {
-        INDEX maxui = -1;
-        auto idx_prev = (idx == 0) ? seq.size()-1 : idx-1;
-        auto idx_pprev = (idx_prev == 0) ? seq.size()-1 : idx_prev-1;
+        // nothing precedes the whole seq
+        if (idx == 0)
+            return;
+
+        auto idx_prev = idx - 1;
         auto c = map_(seq[idx]);
         auto c_prev = map_(seq[idx_prev]);
 
-        // record $ position in bwt as primary index
-        if (idx_pprev == seq.size()-1)
-            primary_index_ = head[c_prev];
-
+        // idx is L-type or LMS, so idx_prev is L-type iff c <= c_prev
         if (c <= c_prev)
-        {
-            L[c_prev].push_back(idx_prev);
-            bwt_[head[c_prev]] = seq[idx_pprev];
-            // sample if mod step is 0
-            if ( (idx_prev & (sample_rate_ - 1)) == 0 ) 
-            {
-                bwt_marked_[head[c_prev]] = true;
-
-                // ofs << head[c_prev] << " " << idx_prev
-                //     << "\n";
-                loc_table_.emplace_back(
-                    std::make_pair(head[c_prev], idx_prev));
-            }
-            if (idx_prev > maxui)
-                pos_bit[head[c_prev]] = true;
-            head[c_prev]++;
-        }
-        else if (is_l_queue)
-            LS[c].push_back(idx);
+            place(idx_prev, buckets.push_l(c_prev, idx_prev), seq, bwt);
     }
 
+    /// @brief Place the S-type suffix preceding suffix idx (if any)
+    ///        at the tail of its bucket
+    /// @param is_s Type of suffix idx
+    template<class BUCKETS>
     void induce_s(
         INDEX idx
+      , bool is_s
       , const SEQ& seq
-      , std::vector<std::list<INDEX>>& S
-      , CTableType& tail
-      , std::vector<bool>& pos_bit
-      , std::ofstream& ofs
+      , PackedVector<BITS>& bwt
+      , BUCKETS& buckets
     )
     {
-        // skip $ because $ is LMS
-        if (idx == seq.size()-1)
+        if (idx == 0)
             return;
-    
-        INDEX maxui = -1;
-        auto idx_prev = (idx == 0) ? seq.size()-1 : idx-1;
-        auto idx_pprev = (idx_prev == 0) ? seq.size()-1 : idx_prev-1;
+
+        auto idx_prev = idx - 1;
         auto c = map_(seq[idx]);
         auto c_prev = map_(seq[idx_prev]);
 
-        // $'s bwt_pos is 0
-        auto bwt_pos = (idx_prev == seq.size()-1) ? 0 : tail[c_prev];
-        if (c_prev <= c)
-        {
-            S[c_prev].push_front(idx_prev);
-            bwt_[bwt_pos] = seq[idx_pprev];
-            // sample if mod step is 0
-            if ( (idx_prev & (sample_rate_ - 1)) == 0 ) 
-            {
-                bwt_marked_[bwt_pos] = true;
-
-                // ofs << bwt_pos << " " << idx_prev 
-                //     << "\n";
-                loc_table_.emplace_back(
-                    std::make_pair(bwt_pos, idx_prev));
-            }
-            if (idx_prev > maxui)
-                pos_bit[bwt_pos] = true;
-
-            if (bwt_pos != 0) // for $
-                tail[c_prev]--;
-        }
+        if (c_prev < c || (c_prev == c && is_s))
+            place(idx_prev, buckets.push_s(c_prev, idx_prev), seq, bwt);
     }
 
-    /// @brief Get occurence of character c uptile bwt index i 
-    /// @param i Bwt index
-    /// @param c Character
-    /// @return Number of occurence
-    INDEX get_occ(INDEX i, CharType c) const
-    { 
-        auto occ_lower_index = i / sample_rate_;
-        auto occ_upper_index = occ_lower_index + 1;
-        auto lower_offset = i & sample_rate_-1;
-        INDEX c_count = 0;
-
-        if (lower_offset <= sample_rate_ / 2 || 
-            occ_upper_index == occ_table_.size())
+    /// @brief Fill the bwt character of suffix idx placed at row pos
+    void place(
+        INDEX idx
+      , INDEX pos
+      , const SEQ& seq
+      , PackedVector<BITS>& bwt
+    )
+    {
+        if (idx == 0) // $ in bwt, record as primary index
         {
-            auto lower_index = occ_lower_index * sample_rate_;
-            for (auto j = lower_index; j < i; j++)
-                if (bwt_[j] == c && j != primary_index_)
-                    c_count++;
-
-            return occ_table_[occ_lower_index][map_(c)] + c_count;
+            primary_index_ = pos;
+            bwt.set(pos, 0);
         }
         else
-        {
-            auto upper_index = occ_upper_index * sample_rate_;
-            for (auto j = i; j < upper_index; j++)
-                if (bwt_[j] == c && j != primary_index_)
-                    c_count++;
+            bwt.set(pos, map_(seq[idx - 1]));
+    }
 
-            return occ_table_[occ_upper_index][map_(c)] - c_count;
-        }
+    /// @brief Map element in last column to first column
+    /// @param i Last column index
+    /// @param c Rank of character
+    /// @return First column index
+    INDEX lf(INDEX i, INDEX c) const
+    {
+        return c_table_[c] + occ_.occ(i, c);
     }
 };
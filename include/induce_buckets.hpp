@@ -0,0 +1,239 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <cassert>
+#include "disk_queue.hpp"
+
+// Bucket stores of the induced sorting. Rows of the first column are
+// split into one bucket per character ($ alone at row 0), L-type
+// suffixes fill a bucket from its head and S-type ones from its tail.
+// Both parts are consumed by the scans in the order they are filled,
+// except the L-type part which the right-to-left scan reads backward,
+// so a store only needs queues, kept either in one flat suffix array
+// (MemoryBuckets) or in scratch files (DiskBuckets).
+//
+// A store provides
+//   push_l(c, idx), push_s(c, idx)  place suffix idx, return its row
+//   for_each_l(c, f)                L-type part of c in row order,
+//                                   including suffixes pushed by f
+//   for_each_lms(c, f)              sorted LMS suffixes starting by c
+//   for_each_s(c, f)                S-type part of c by decreasing
+//                                   row, including suffixes pushed by f
+//   for_each_l_reverse(c, f)        L-type part of c by decreasing row
+//   for_each_row(f)                 the suffix array, once induced
+
+/// @brief Head and tail cursors of the buckets
+template<typename INDEX, int BITS>
+struct BucketCursors
+{
+    using CTableType = std::array<INDEX, (1 << BITS)>;
+
+    /// @brief First and last row of each bucket, $ excluded
+    CTableType begin, end;
+
+    /// @brief Next row to fill by L-type and by S-type suffixes
+    CTableType head, tail;
+
+    /// @param c_table Start row of each character
+    /// @param n Sequence size, $ included
+    BucketCursors(const CTableType& c_table, INDEX n)
+    {
+        for (std::size_t c = 0; c < c_table.size(); c++)
+        {
+            begin[c] = (c == 0) ? 1 : c_table[c];
+            end[c] = (c == c_table.size() - 1) ? n - 1 : c_table[c+1] - 1;
+        }
+        head = begin;
+        tail = end;
+    }
+};
+
+/// @brief Buckets laid out in one flat suffix array, the filled part
+///        of a bucket being its queue
+template<typename INDEX, int BITS, typename VECTOR = std::vector<INDEX>>
+class MemoryBuckets
+{
+    using CTableType = typename BucketCursors<INDEX, BITS>::CTableType;
+
+    BucketCursors<INDEX, BITS> cursors_;
+    VECTOR                     sa_;
+    VECTOR                     lms_sa_;
+    CTableType                 lms_count_;
+    std::size_t                lms_pos_ = 1;
+
+  public:
+    /// @param lms_sa Sorted LMS suffixes, $ first
+    /// @param lms_count Number of LMS suffixes starting by each
+    ///        character
+    MemoryBuckets(
+        const CTableType& c_table
+      , INDEX n
+      , VECTOR lms_sa
+      , const CTableType& lms_count
+    )
+        : cursors_(c_table, n)
+        , sa_(n)
+        , lms_sa_(std::move(lms_sa))
+        , lms_count_(lms_count)
+    {
+        sa_[0] = n - 1;
+    }
+
+    INDEX push_l(INDEX c, INDEX idx)
+    {
+        auto pos = cursors_.head[c]++;
+        sa_[pos] = idx;
+        return pos;
+    }
+
+    INDEX push_s(INDEX c, INDEX idx)
+    {
+        auto pos = cursors_.tail[c]--;
+        sa_[pos] = idx;
+        return pos;
+    }
+
+    template<class F>
+    void for_each_l(INDEX c, F f)
+    {
+        for (auto i = cursors_.begin[c]; i < cursors_.head[c]; i++)
+            f(sa_[i]);
+    }
+
+    template<class F>
+    void for_each_lms(INDEX c, F f)
+    {
+        for (INDEX k = 0; k < lms_count_[c]; k++)
+            f(lms_sa_[lms_pos_++]);
+    }
+
+    template<class F>
+    void for_each_s(INDEX c, F f)
+    {
+        for (auto i = cursors_.end[c]; i > cursors_.tail[c]; i--)
+            f(sa_[i]);
+    }
+
+    template<class F>
+    void for_each_l_reverse(INDEX c, F f)
+    {
+        for (auto i = cursors_.head[c]; i > cursors_.begin[c]; i--)
+            f(sa_[i-1]);
+    }
+
+    /// @brief Suffix array, once induced
+    const VECTOR& sa() const
+    { return sa_; }
+};
+
+/// @brief Buckets kept in scratch files, two queues per character
+///        plus one of the sorted LMS suffixes. Memory use is bounded by
+///        the buffers, sa_budget split among the queues.
+template<typename INDEX, int BITS, typename VECTOR = std::vector<INDEX>>
+class DiskBuckets
+{
+    using CTableType = typename BucketCursors<INDEX, BITS>::CTableType;
+
+    BucketCursors<INDEX, BITS>    cursors_;
+    INDEX                         size_;
+    std::vector<DiskQueue<INDEX>> l_queues_;
+    std::vector<DiskQueue<INDEX>> s_queues_;
+    DiskQueue<INDEX>              lms_queue_;
+    CTableType                    lms_count_;
+
+  public:
+    /// @param lms_sa Sorted LMS suffixes, $ first. Spilled to the
+    ///        scratch directory and released.
+    /// @param lms_count Number of LMS suffixes starting by each
+    ///        character
+    DiskBuckets(
+        const CTableType& c_table
+      , INDEX n
+      , VECTOR lms_sa
+      , const CTableType& lms_count
+      , const ExternalMemory& external
+    )
+        : cursors_(c_table, n)
+        , size_(n)
+        , lms_queue_(external.scratch_dir, buffer_size(external))
+        , lms_count_(lms_count)
+    {
+        for (std::size_t c = 0; c < c_table.size(); c++)
+        {
+            l_queues_.emplace_back(
+                external.scratch_dir, buffer_size(external));
+            s_queues_.emplace_back(
+                external.scratch_dir, buffer_size(external));
+        }
+        for (std::size_t i = 1; i < lms_sa.size(); i++)
+            lms_queue_.push(lms_sa[i]);
+    }
+
+    INDEX push_l(INDEX c, INDEX idx)
+    {
+        l_queues_[c].push(idx);
+        return cursors_.head[c]++;
+    }
+
+    INDEX push_s(INDEX c, INDEX idx)
+    {
+        s_queues_[c].push(idx);
+        return cursors_.tail[c]--;
+    }
+
+    template<class F>
+    void for_each_l(INDEX c, F f)
+    {
+        for (INDEX idx; l_queues_[c].pop(idx); )
+            f(idx);
+    }
+
+    template<class F>
+    void for_each_lms(INDEX c, F f)
+    {
+        INDEX idx = 0;
+        for (INDEX k = 0; k < lms_count_[c]; k++)
+        {
+            lms_queue_.pop(idx);
+            f(idx);
+        }
+    }
+
+    template<class F>
+    void for_each_s(INDEX c, F f)
+    {
+        for (INDEX idx; s_queues_[c].pop(idx); )
+            f(idx);
+    }
+
+    template<class F>
+    void for_each_l_reverse(INDEX c, F f)
+    {
+        l_queues_[c].for_each_reverse(f);
+    }
+
+    /// @brief Stream the suffix array in row order: $, then each
+    ///        bucket's L-type part forward and S-type part backward
+    template<class F>
+    void for_each_row(F f)
+    {
+        f(size_ - 1);
+        for (std::size_t c = 0; c < l_queues_.size(); c++)
+        {
+            assert(cursors_.head[c] == cursors_.tail[c] + 1);
+            l_queues_[c].rewind();
+            for (INDEX idx; l_queues_[c].pop(idx); )
+                f(idx);
+            s_queues_[c].for_each_reverse(f);
+        }
+    }
+
+  private:
+    /// @brief Elements per buffer, each queue has a write and a read
+    ///        buffer
+    static std::size_t buffer_size(const ExternalMemory& external)
+    {
+        auto queues = 2 * (std::size_t(1) << BITS) + 1;
+        return external.sa_budget / (2 * queues * sizeof(INDEX));
+    }
+};
@@ -0,0 +1,155 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <numeric>
+#include <ostream>
+#include <algorithm>
+#include <stdexcept>
+#include "mapped_array.hpp"
+#include "thread_pool.hpp"
+
+/// @brief SA interval of every k-mer, so a backward search can start
+///        from the interval of the pattern's last k characters. A
+///        k-mer is coded by the ranks of its characters, BITS bits
+///        each, the first character being the most significant, so
+///        codes are in lexicographic order.
+///
+/// begin_[x] is the number of suffixes smaller than k-mer x. Its
+/// interval ends at begin_[x+1] unless a suffix shorter than k (one
+/// of the last k-1 suffixes) sorts in between, those are kept in
+/// short_codes_ by the code of the k-mer right after them.
+template<typename INDEX, int BITS>
+class KmerTable
+{
+    MappedArray<INDEX>    begin_;
+    MappedArray<uint64_t> short_codes_;
+    unsigned              k_ = 0;
+
+  public:
+    /// @brief Largest supported BITS * k, the table has 2^(BITS * k)
+    ///        entries
+    static constexpr unsigned max_code_bits = 32;
+
+    KmerTable() = default;
+
+    /// @param seq Sequence, $(smalest alphabet) at the end
+    /// @param map Map alphabet to their rank
+    /// @param k K-mer length, 0 for no table
+    template<class SEQ, class MAPPER>
+    KmerTable(const SEQ& seq, const MAPPER& map, unsigned k
+            , ThreadPool& pool)
+        : k_(k)
+    {
+        if (k == 0)
+            return;
+        if (BITS * k > max_code_bits)
+            throw std::runtime_error(
+                "k-mer table too large, k=" + std::to_string(k));
+
+        std::size_t n = seq.size();
+        std::size_t kmer_count = uint64_t(1) << (BITS * k);
+        begin_.resize(kmer_count + 1);
+
+        // Count k-mers not containing $, windows [p, p+k) for
+        // p + k <= n-1
+        std::size_t windows = (n - 1 >= k) ? n - k : 0;
+        auto concurrent = pool.size() > 1;
+        pool.parallel_for(windows,
+            [this, &seq, &map, concurrent](auto begin, auto end, auto)
+            {
+                uint64_t code = 0;
+                for (auto p = begin; p < begin + k_ - 1; p++)
+                    code = push(code, map(seq[p]));
+                for (auto p = begin; p < end; p++)
+                {
+                    code = push(code, map(seq[p + k_ - 1]));
+                    if (concurrent)
+                        __atomic_fetch_add(
+                            &begin_[code], 1, __ATOMIC_RELAXED);
+                    else
+                        begin_[code]++;
+                }
+            });
+
+        // Suffixes shorter than k sort right before the k-mer of
+        // their characters padded by rank 0
+        for (auto p = windows; p + 1 < n; p++)
+        {
+            uint64_t code = 0;
+            for (auto q = p; q + 1 < n; q++)
+                code = (code << BITS) | map(seq[q]);
+            short_codes_.emplace_back(code << (BITS * (k - (n-1-p))));
+        }
+        std::sort(short_codes_.begin(), short_codes_.end());
+
+        // begin_[x] = 1 ($) + k-mers before x + short suffixes up to x
+        std::vector<INDEX> chunk_sum(pool.size() + 1);
+        pool.parallel_for(kmer_count + 1,
+            [this, &chunk_sum](auto begin, auto end, auto tid)
+            {
+                for (auto x = begin; x < end; x++)
+                    chunk_sum[tid + 1] += begin_[x];
+            });
+        chunk_sum[0] = 1;
+        std::partial_sum(
+            chunk_sum.begin(), chunk_sum.end(), chunk_sum.begin());
+        pool.parallel_for(kmer_count + 1,
+            [this, &chunk_sum](auto begin, auto end, auto tid)
+            {
+                auto sum = chunk_sum[tid];
+                std::size_t s = std::lower_bound(short_codes_.begin()
+                    , short_codes_.end(), begin) - short_codes_.begin();
+                for (auto x = begin; x < end; x++)
+                {
+                    std::swap(sum, begin_[x]);
+                    sum += begin_[x];
+                    // short suffixes before x, kept by later x too
+                    while (s < short_codes_.size() && short_codes_[s] == x)
+                        s++;
+                    begin_[x] += s;
+                }
+            });
+    }
+
+    /// @brief K-mer length, 0 if there is no table
+    unsigned k() const
+    { return k_; }
+
+    /// @brief SA interval [begin, end) of a k-mer
+    std::pair<INDEX, INDEX> range(uint64_t code) const
+    {
+        auto shorts = std::equal_range(
+            short_codes_.begin(), short_codes_.end(), code + 1);
+        return std::make_pair(begin_[code]
+          , begin_[code + 1] - (shorts.second - shorts.first));
+    }
+
+    /// @brief Code after appending a character to a code
+    uint64_t push(uint64_t code, uint64_t rank) const
+    {
+        return ((code << BITS) | rank)
+             & ((uint64_t(1) << (BITS * k_)) - 1);
+    }
+
+    void save(std::ostream& os) const
+    {
+        save_pod(os, uint64_t(k_));
+        begin_.save(os);
+        short_codes_.save(os);
+    }
+
+    void map(const char*& ptr, const char* end)
+    {
+        uint64_t k;
+        map_pod(ptr, end, k);
+        begin_.map(ptr, end);
+        short_codes_.map(ptr, end);
+        if (BITS * k > max_code_bits || (k != 0 &&
+            begin_.size() != (uint64_t(1) << (BITS * k)) + 1))
+            throw std::runtime_error("corrupted index file");
+        k_ = k;
+    }
+};
+
+template<typename INDEX, int BITS>
+constexpr unsigned KmerTable<INDEX, BITS>::max_code_bits;
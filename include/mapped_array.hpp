@@ -0,0 +1,263 @@
+#pragma once
+#include <cstdint>
+#include <cassert>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdlib>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/// @brief Read-only memory mapping of a whole file, unmapped on
+///        destruction
+class MmapFile
+{
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+
+  public:
+    explicit MmapFile(const std::string& path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("can not open " + path);
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("can not stat " + path);
+        }
+        size_ = st.st_size;
+
+        if (size_ != 0)
+        {
+            void* addr = ::mmap(
+                nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+            if (addr == MAP_FAILED)
+            {
+                ::close(fd);
+                throw std::runtime_error("can not mmap " + path);
+            }
+            data_ = static_cast<const char*>(addr);
+        }
+        ::close(fd); // mapping stays valid after close
+    }
+
+    MmapFile(const MmapFile&) = delete;
+    MmapFile& operator=(const MmapFile&) = delete;
+
+    ~MmapFile()
+    {
+        if (data_)
+            ::munmap(const_cast<char*>(data_), size_);
+    }
+
+    const char* data() const { return data_; }
+    std::size_t size() const { return size_; }
+};
+
+/// @brief Write a trivially copyable value as raw bytes
+template<class T>
+void save_pod(std::ostream& os, const T& value)
+{
+    os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+/// @brief Read a value written by save_pod() from a mapped buffer
+/// @param ptr Start of the value, advanced past it on return
+/// @param end End of the mapped buffer
+template<class T>
+void map_pod(const char*& ptr, const char* end, T& value)
+{
+    if (end - ptr < static_cast<std::ptrdiff_t>(sizeof(value)))
+        throw std::runtime_error("truncated index file");
+    std::copy(ptr, ptr + sizeof(value),
+              reinterpret_cast<char*>(&value));
+    ptr += sizeof(value);
+}
+
+/// @brief Allocator returning cache line aligned memory
+template<class T>
+struct CacheAlignedAllocator
+{
+    using value_type = T;
+    static constexpr std::size_t alignment = 64;
+
+    CacheAlignedAllocator() = default;
+    template<class U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U>&) {}
+
+    T* allocate(std::size_t n)
+    {
+        void* ptr = nullptr;
+        if (::posix_memalign(&ptr, alignment, n * sizeof(T)) != 0)
+            throw std::bad_alloc();
+        return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T* ptr, std::size_t)
+    { std::free(ptr); }
+
+    template<class U>
+    bool operator==(const CacheAlignedAllocator<U>&) const
+    { return true; }
+    template<class U>
+    bool operator!=(const CacheAlignedAllocator<U>&) const
+    { return false; }
+};
+
+/// @brief Contiguous array which either owns its elements or views
+///        an external read-only buffer (e.g. a mmap'd index file).
+///        Element type must be trivially copyable, as it is written
+///        and mapped as raw bytes. Elements always start on a cache
+///        line.
+///
+/// On disk an array is stored as its element count (uint64), padding
+/// up to the next 64-byte file offset, the raw elements, and padding
+/// to 8 bytes. Since mmap returns page aligned memory, mapped
+/// elements are cache line aligned as well.
+template<class T>
+class MappedArray
+{
+    static constexpr std::size_t alignment = 
+        CacheAlignedAllocator<T>::alignment;
+
+    std::vector<T, CacheAlignedAllocator<T>> owned_;
+
+    /// @brief Points to owned_ or to the mapped buffer
+    const T*       data_   = nullptr;
+    std::size_t    size_   = 0;
+    bool           mapped_ = false;
+
+  public:
+    using value_type     = T;
+    using iterator       = T*;
+    using const_iterator = const T*;
+
+    MappedArray() = default;
+
+    MappedArray(const MappedArray& rhs)
+        : owned_(rhs.owned_)
+        , data_(rhs.data_)
+        , size_(rhs.size_)
+        , mapped_(rhs.mapped_)
+    {
+        if (!mapped_)
+            refresh();
+    }
+
+    MappedArray(MappedArray&& rhs) noexcept
+        : owned_(std::move(rhs.owned_))
+        , data_(rhs.data_)
+        , size_(rhs.size_)
+        , mapped_(rhs.mapped_)
+    {
+        if (!mapped_)
+            refresh();
+        rhs.clear();
+    }
+
+    MappedArray& operator=(MappedArray rhs) noexcept
+    {
+        owned_.swap(rhs.owned_);
+        data_ = rhs.data_;
+        size_ = rhs.size_;
+        mapped_ = rhs.mapped_;
+        if (!mapped_)
+            refresh();
+        return *this;
+    }
+
+    const T& operator[](std::size_t i) const { return data_[i]; }
+    const T* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    bool is_mapped() const { return mapped_; }
+    const_iterator begin() const { return data_; }
+    const_iterator end() const { return data_ + size_; }
+
+    /// @brief Mutable access, only valid while owning the elements
+    T& operator[](std::size_t i)
+    {
+        assert(!mapped_);
+        return owned_[i];
+    }
+    iterator begin() { assert(!mapped_); return owned_.data(); }
+    iterator end() { assert(!mapped_); return owned_.data() + size_; }
+
+    void resize(std::size_t n, const T& value = T())
+    {
+        assert(!mapped_);
+        owned_.resize(n, value);
+        refresh();
+    }
+
+    template<class... ARGS>
+    void emplace_back(ARGS&&... args)
+    {
+        assert(!mapped_);
+        owned_.emplace_back(std::forward<ARGS>(args)...);
+        refresh();
+    }
+
+    void clear()
+    {
+        owned_.clear();
+        mapped_ = false;
+        refresh();
+    }
+
+    /// @brief Write element count and elements, os must be
+    ///        positioned relative to the start of the file
+    void save(std::ostream& os) const
+    {
+        static const char pad[alignment] {};
+        save_pod(os, uint64_t(size_));
+        os.write(pad, padding(
+            static_cast<std::size_t>(os.tellp()), alignment));
+        os.write(reinterpret_cast<const char*>(data_),
+                 size_ * sizeof(T));
+        os.write(pad, padding(size_ * sizeof(T)));
+    }
+
+    /// @brief View an array previously written by save()
+    /// @param ptr Start of the array, advanced past it on return
+    /// @param end End of the mapped buffer
+    void map(const char*& ptr, const char* end)
+    {
+        uint64_t size;
+        map_pod(ptr, end, size);
+        ptr += padding(reinterpret_cast<std::uintptr_t>(ptr), alignment);
+
+        auto bytes = size * sizeof(T);
+        if (ptr > end || static_cast<uint64_t>(end - ptr) < bytes)
+            throw std::runtime_error("truncated index file");
+
+        owned_.clear();
+        owned_.shrink_to_fit();
+        data_ = reinterpret_cast<const T*>(ptr);
+        size_ = size;
+        mapped_ = true;
+        ptr += bytes + padding(bytes);
+    }
+
+    /// @brief Number of bytes needed to pad n bytes to a multiple of
+    ///        align (power of 2)
+    static std::size_t padding(std::size_t n, std::size_t align = 8)
+    {
+        return (align - (n & (align - 1))) & (align - 1);
+    }
+
+  private:
+    void refresh()
+    {
+        data_ = owned_.data();
+        size_ = owned_.size();
+    }
+};
@@ -0,0 +1,359 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+#include <ostream>
+#include <stdexcept>
+#include "mapped_array.hpp"
+
+/// @brief Fixed-width integer vector, each element takes BITS bits.
+///        Elements never straddle a 64-bit word, so a word holds
+///        64/BITS elements.
+template<int BITS>
+class PackedVector
+{
+    static_assert(BITS > 0 && BITS <= 32, "BITS must be in [1, 32]");
+
+    MappedArray<uint64_t> words_;
+    std::size_t           size_ = 0;
+
+  public:
+    static constexpr int      per_word = 64 / BITS;
+    static constexpr uint64_t mask     = (uint64_t(1) << BITS) - 1;
+
+    PackedVector() = default;
+
+    explicit PackedVector(std::size_t n)
+    { resize(n); }
+
+    void resize(std::size_t n)
+    {
+        size_ = n;
+        words_.resize((n + per_word - 1) / per_word);
+    }
+
+    uint64_t get(std::size_t i) const
+    {
+        return (words_[i / per_word] >> (i % per_word * BITS)) & mask;
+    }
+
+    uint64_t operator[](std::size_t i) const
+    { return get(i); }
+
+    void set(std::size_t i, uint64_t value)
+    {
+        auto shift = i % per_word * BITS;
+        auto& word = words_[i / per_word];
+        word = (word & ~(mask << shift)) | ((value & mask) << shift);
+    }
+
+    std::size_t size() const { return size_; }
+
+    /// @brief Underlying words, element i is in word i/per_word
+    const MappedArray<uint64_t>& words() const { return words_; }
+
+    void save(std::ostream& os) const
+    {
+        save_pod(os, uint64_t(size_));
+        words_.save(os);
+    }
+
+    void map(const char*& ptr, const char* end)
+    {
+        uint64_t size;
+        map_pod(ptr, end, size);
+        words_.map(ptr, end);
+        if (words_.size() != (size + per_word - 1) / per_word)
+            throw std::runtime_error("corrupted index file");
+        size_ = size;
+    }
+};
+
+template<int BITS>
+constexpr int PackedVector<BITS>::per_word;
+template<int BITS>
+constexpr uint64_t PackedVector<BITS>::mask;
+
+/// @brief Integer vector with the element width given at runtime.
+///        Elements are packed back to back and may straddle two
+///        words, so n elements take about n * width bits.
+class IntVector
+{
+    MappedArray<uint64_t> words_;
+    std::size_t           size_  = 0;
+    int                   width_ = 1;
+    uint64_t              mask_  = 1;
+
+  public:
+    IntVector() = default;
+
+    /// @param n Number of elements, all zero
+    /// @param width Bits per element, in [1, 64]
+    IntVector(std::size_t n, int width)
+        : size_(n)
+    {
+        set_width(width);
+        words_.resize((n * width_ + 63) / 64);
+    }
+
+    /// @brief Bits needed to store values up to max_value, at least 1
+    static int bit_width(uint64_t max_value)
+    {
+        int width = 1;
+        while (width < 64 && (max_value >> width))
+            width++;
+        return width;
+    }
+
+    uint64_t get(std::size_t i) const
+    {
+        auto bit = i * width_;
+        auto offset = bit % 64;
+        uint64_t value = words_[bit / 64] >> offset;
+        if (offset + width_ > 64)
+            value |= words_[bit / 64 + 1] << (64 - offset);
+        return value & mask_;
+    }
+
+    uint64_t operator[](std::size_t i) const
+    { return get(i); }
+
+    /// @brief Set i-th element. Different threads may only set
+    ///        elements in disjoint ranges of 64 elements (which cover
+    ///        whole words).
+    void set(std::size_t i, uint64_t value)
+    {
+        auto bit = i * width_;
+        auto offset = bit % 64;
+        auto& word = words_[bit / 64];
+        value &= mask_;
+        word = (word & ~(mask_ << offset)) | (value << offset);
+        if (offset + width_ > 64)
+        {
+            auto& next = words_[bit / 64 + 1];
+            auto shift = 64 - offset;
+            next = (next & ~(mask_ >> shift)) | (value >> shift);
+        }
+    }
+
+    std::size_t size() const { return size_; }
+    int width() const { return width_; }
+
+    void save(std::ostream& os) const
+    {
+        save_pod(os, uint64_t(size_));
+        save_pod(os, uint64_t(width_));
+        words_.save(os);
+    }
+
+    void map(const char*& ptr, const char* end)
+    {
+        uint64_t size, width;
+        map_pod(ptr, end, size);
+        map_pod(ptr, end, width);
+        if (width < 1 || width > 64)
+            throw std::runtime_error("corrupted index file");
+        words_.map(ptr, end);
+        if (words_.size() != (size * width + 63) / 64)
+            throw std::runtime_error("corrupted index file");
+        size_ = size;
+        set_width(width);
+    }
+
+  private:
+    void set_width(int width)
+    {
+        width_ = width;
+        mask_ = (width == 64) ? ~uint64_t(0) 
+                              : (uint64_t(1) << width) - 1;
+    }
+};
+
+template<class VECTOR>
+constexpr int element_bits_impl(decltype(VECTOR::value_bits)*)
+{ return VECTOR::value_bits; }
+
+template<class VECTOR>
+constexpr int element_bits_impl(...)
+{ return sizeof(typename VECTOR::value_type) * 8; }
+
+/// @brief Bits an element of VECTOR holds, VECTOR::value_bits if it
+///        packs elements narrower than its value_type (e.g.
+///        Int40Vector), otherwise the bits of value_type
+template<class VECTOR>
+constexpr int element_bits()
+{ return element_bits_impl<VECTOR>(nullptr); }
+
+/// @brief Vector of 40-bit integers taking 5 bytes each, for suffix
+///        arrays of texts beyond 4G at 5/8 of the size of uint64_t.
+///        Values are read back sign extended from bit 39, so it holds
+///        [-2^39, 2^39) (as uint64_t), which is what SACA_K needs for
+///        its negative counters and EMPTY marker. Elements do not
+///        share bytes, so threads may set different elements.
+class Int40Vector
+{
+    static constexpr int bytes = 5;
+
+    std::vector<uint8_t> bytes_;
+
+  public:
+    using value_type = uint64_t;
+    using size_type  = std::size_t;
+
+    /// @brief Bits per element, SACA_K takes its top bit as sign
+    static constexpr int value_bits = 8 * bytes;
+
+    /// @brief Proxy to an element
+    class reference
+    {
+        uint8_t* ptr_;
+
+      public:
+        explicit reference(uint8_t* ptr) : ptr_(ptr) {}
+        reference(const reference&) = default;
+
+        operator value_type() const
+        {
+            // sign extend from bit 39 without shifting a negative
+            uint32_t low;
+            uint8_t high;
+            std::memcpy(&low, ptr_, 4);
+            std::memcpy(&high, ptr_ + 4, 1);
+            uint64_t value = (uint64_t(high) << 32) | low;
+            return (high & 0x80) ? value | ~((uint64_t(1) << 40) - 1)
+                                 : value;
+        }
+
+        reference& operator=(value_type value)
+        {
+            uint32_t low = value;
+            uint8_t high = value >> 32;
+            std::memcpy(ptr_, &low, 4);
+            std::memcpy(ptr_ + 4, &high, 1);
+            return *this;
+        }
+
+        /// @brief Assign the value, not the proxy
+        reference& operator=(const reference& other)
+        { return *this = static_cast<value_type>(other); }
+
+        reference& operator+=(value_type v)
+        { return *this = static_cast<value_type>(*this) + v; }
+        reference& operator-=(value_type v)
+        { return *this = static_cast<value_type>(*this) - v; }
+        reference& operator++()
+        { return *this += 1; }
+        reference& operator--()
+        { return *this -= 1; }
+        value_type operator++(int)
+        { value_type old = *this; *this += 1; return old; }
+        value_type operator--(int)
+        { value_type old = *this; *this -= 1; return old; }
+
+        friend void swap(reference a, reference b)
+        {
+            value_type tmp = a;
+            a = static_cast<value_type>(b);
+            b = tmp;
+        }
+    };
+
+    /// @brief Random access iterator yielding reference proxies, or
+    ///        values if IS_CONST
+    template<bool IS_CONST>
+    class basic_iterator
+    {
+        uint8_t* ptr_ = nullptr;
+
+      public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type        = Int40Vector::value_type;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = void;
+        using reference         = std::conditional_t<
+            IS_CONST, value_type, Int40Vector::reference>;
+
+        basic_iterator() = default;
+        explicit basic_iterator(uint8_t* ptr) : ptr_(ptr) {}
+
+        reference operator*() const
+        { return Int40Vector::reference(ptr_); }
+        reference operator[](difference_type i) const
+        { return Int40Vector::reference(ptr_ + i * bytes); }
+
+        basic_iterator& operator++()
+        { ptr_ += bytes; return *this; }
+        basic_iterator& operator--()
+        { ptr_ -= bytes; return *this; }
+        basic_iterator operator++(int)
+        { auto old = *this; ++*this; return old; }
+        basic_iterator operator--(int)
+        { auto old = *this; --*this; return old; }
+        basic_iterator& operator+=(difference_type i)
+        { ptr_ += i * bytes; return *this; }
+        basic_iterator& operator-=(difference_type i)
+        { ptr_ -= i * bytes; return *this; }
+        basic_iterator operator+(difference_type i) const
+        { return basic_iterator(ptr_ + i * bytes); }
+        basic_iterator operator-(difference_type i) const
+        { return basic_iterator(ptr_ - i * bytes); }
+        friend basic_iterator operator+(difference_type i, basic_iterator it)
+        { return it + i; }
+        difference_type operator-(basic_iterator other) const
+        { return (ptr_ - other.ptr_) / bytes; }
+
+        bool operator==(basic_iterator other) const
+        { return ptr_ == other.ptr_; }
+        bool operator!=(basic_iterator other) const
+        { return ptr_ != other.ptr_; }
+        bool operator<(basic_iterator other) const
+        { return ptr_ < other.ptr_; }
+        bool operator>(basic_iterator other) const
+        { return ptr_ > other.ptr_; }
+        bool operator<=(basic_iterator other) const
+        { return ptr_ <= other.ptr_; }
+        bool operator>=(basic_iterator other) const
+        { return ptr_ >= other.ptr_; }
+    };
+
+    using iterator       = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    Int40Vector() = default;
+
+    /// @param n Number of elements, all zero
+    explicit Int40Vector(std::size_t n)
+        : bytes_(n * bytes)
+    {}
+
+    reference operator[](std::size_t i)
+    { return reference(bytes_.data() + i * bytes); }
+
+    value_type operator[](std::size_t i) const
+    { return reference(const_cast<uint8_t*>(bytes_.data()) + i * bytes); }
+
+    iterator begin()
+    { return iterator(bytes_.data()); }
+
+    iterator end()
+    { return iterator(bytes_.data() + bytes_.size()); }
+
+    const_iterator begin() const
+    { return const_iterator(const_cast<uint8_t*>(bytes_.data())); }
+
+    const_iterator end() const
+    { return const_iterator(
+        const_cast<uint8_t*>(bytes_.data() + bytes_.size())); }
+
+    std::size_t size() const
+    { return bytes_.size() / bytes; }
+
+    void resize(std::size_t n)
+    { bytes_.resize(n * bytes); }
+
+    void swap(Int40Vector& other)
+    { bytes_.swap(other.bytes_); }
+};
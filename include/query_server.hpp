@@ -0,0 +1,540 @@
+#pragma once
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Query protocol of QueryServer over a Unix domain socket, in host
+// byte order (client and server share the host). A request is a batch
+// of patterns:
+//
+//     RequestHeader {op, patterns}, then per pattern
+//         uint32_t length, length characters
+//
+// answered by
+//
+//     ResponseHeader {status, results}, then per pattern
+//         count:  uint64_t count
+//         locate: uint64_t n, n uint64_t locations (bwt order)
+//
+// A connection carries any number of requests, answered in order. A
+// request the server can not parse is answered by a non-zero status
+// and the connection closed.
+struct QueryProtocol
+{
+    enum Op : uint32_t
+    {
+        count  = 1,
+        locate = 2,
+    };
+
+    enum Status : uint32_t
+    {
+        ok          = 0,
+        bad_request = 1,
+    };
+
+    struct RequestHeader
+    {
+        uint32_t op;
+        uint32_t patterns;
+    };
+
+    struct ResponseHeader
+    {
+        uint32_t status;
+        uint32_t results;
+    };
+
+    /// @brief Limits of a request, larger ones are bad requests
+    static constexpr uint32_t max_patterns = 1 << 20;
+    static constexpr uint32_t max_length   = 1 << 20;
+
+    /// @brief Most bytes of a request, as the server buffers it whole
+    static constexpr uint64_t max_request  = 64 << 20;
+
+    /// @brief Read exactly size bytes
+    /// @return false on end of file or error
+    static bool read_full(int fd, void* buf, std::size_t size)
+    {
+        auto ptr = static_cast<char*>(buf);
+        while (size != 0)
+        {
+            auto n = ::read(fd, ptr, size);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            ptr += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    /// @brief Write exactly size bytes, without SIGPIPE if the peer
+    ///        has gone
+    /// @return false on error
+    static bool write_full(int fd, const void* buf, std::size_t size)
+    {
+        auto ptr = static_cast<const char*>(buf);
+        while (size != 0)
+        {
+            auto n = ::send(fd, ptr, size, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            ptr += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    template<class T>
+    static void append(std::vector<char>& buf, const T& value)
+    {
+        auto ptr = reinterpret_cast<const char*>(&value);
+        buf.insert(buf.end(), ptr, ptr + sizeof(value));
+    }
+
+    static sockaddr_un socket_address(const std::string& path)
+    {
+        sockaddr_un addr {};
+        if (path.size() >= sizeof(addr.sun_path))
+            throw std::runtime_error("socket path too long " + path);
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        return addr;
+    }
+};
+
+/// @brief Serve count and locate requests (see QueryProtocol) on a
+///        Unix domain socket from one shared, typically mapped, index.
+///        A fixed pool of workers waits on one epoll set holding the
+///        listening socket and every connection, each connection armed
+///        for a single event. Connections are non-blocking: the worker
+///        woken by a connection appends what has arrived to its buffer,
+///        answers the requests complete in it and re-arms it, so a
+///        client sending part of a request holds no worker. Responses
+///        the client does not read yet are kept and sent once it does,
+///        the connection being read again after that. Batches of all
+///        clients are thus spread over the workers at the cost of one
+///        wake-up, while a client's requests are answered in order.
+/// @tparam FM_INDEX FmIndex (or anything with count() and locate()
+///         of a std::string)
+template<class FM_INDEX>
+class QueryServer
+{
+    /// @brief A connection, owned by the worker of its armed event
+    struct Connection
+    {
+        int               fd;
+
+        /// @brief Bytes received, the first answered of them dropped
+        ///        once the requests complete in in are answered
+        std::vector<char> in;
+        std::size_t       answered = 0;
+
+        /// @brief End of the bytes of in checked to hold whole patterns
+        ///        of the first request not answered (0 if none are),
+        ///        and the number of those patterns
+        std::size_t       scanned = 0;
+        uint32_t          patterns = 0;
+
+        /// @brief Response bytes not yet sent
+        std::vector<char> out;
+        std::size_t       sent = 0;
+
+        /// @brief Close once out is sent (after a bad request)
+        bool              closing = false;
+    };
+
+    const FM_INDEX&   index_;
+    std::string       path_;
+    unsigned          threads_;
+    int               listen_fd_ = -1;
+    int               epoll_fd_ = -1;
+
+    /// @brief Written to stop, never read so that every worker wakes
+    int               stop_[2] = {-1, -1};
+
+    /// @brief Open connections by fd, closed when run() returns
+    std::mutex        mutex_;
+    std::map<int, std::unique_ptr<Connection>> connections_;
+
+  public:
+    /// @param index Index to query, must outlive the server
+    /// @param path Socket path, replaced if it exists
+    /// @param threads Number of workers, 0 for all hardware threads
+    QueryServer(const FM_INDEX& index, const std::string& path
+              , unsigned threads)
+        : index_(index)
+        , path_(path)
+        , threads_(threads ? threads
+                 : std::max(1u, std::thread::hardware_concurrency()))
+    {
+        auto addr = QueryProtocol::socket_address(path);
+        listen_fd_ = ::socket(AF_UNIX
+                            , SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0)
+            throw std::runtime_error("can not create socket");
+        ::unlink(path.c_str());
+        epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr)
+                 , sizeof(addr)) != 0
+         || ::listen(listen_fd_, SOMAXCONN) != 0
+         || ::pipe2(stop_, O_CLOEXEC) != 0
+         || epoll_fd_ < 0
+         || !watch(listen_fd_, EPOLL_CTL_ADD, EPOLLIN)
+         || !watch(stop_[0], EPOLL_CTL_ADD, EPOLLIN))
+        {
+            close_all();
+            throw std::runtime_error("can not listen on " + path);
+        }
+    }
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    ~QueryServer()
+    {
+        close_all();
+        ::unlink(path_.c_str());
+    }
+
+    /// @brief Serve until stop() is called, the calling thread being
+    ///        one of the workers. Connections are closed on return.
+    void run()
+    {
+        std::vector<std::thread> workers;
+        for (unsigned i = 1; i < threads_; i++)
+            workers.emplace_back([this]{ work(); });
+        work();
+        for (auto& worker : workers)
+            worker.join();
+
+        for (const auto& connection : connections_)
+            ::close(connection.first);
+        connections_.clear();
+    }
+
+    /// @brief Make run() return once the requests being answered are.
+    ///        Safe from any thread.
+    void stop()
+    {
+        char byte = 0;
+        while (::write(stop_[1], &byte, 1) < 0 && errno == EINTR)
+            ;
+    }
+
+  private:
+    /// @brief Add or modify fd in the epoll set
+    bool watch(int fd, int op, uint32_t events)
+    {
+        epoll_event event {};
+        event.events = events;
+        event.data.fd = fd;
+        return ::epoll_ctl(epoll_fd_, op, fd, &event) == 0;
+    }
+
+    void work()
+    {
+        while (true)
+        {
+            epoll_event event;
+            auto n = ::epoll_wait(epoll_fd_, &event, 1, -1);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 || event.data.fd == stop_[0])
+                return;
+
+            if (event.data.fd == listen_fd_)
+            {
+                // woken workers race for the connection, the losers
+                // get EAGAIN
+                int fd = ::accept4(listen_fd_, nullptr, nullptr
+                                 , SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0)
+                    continue;
+                std::unique_ptr<Connection> connection(new Connection);
+                connection->fd = fd;
+                std::lock_guard<std::mutex> lock(mutex_);
+                connections_.emplace(fd, std::move(connection));
+                watch(fd, EPOLL_CTL_ADD, EPOLLIN | EPOLLONESHOT);
+                continue;
+            }
+
+            Connection* connection;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                connection = connections_.at(event.data.fd).get();
+            }
+            if (!serve(*connection))
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                int fd = connection->fd;
+                ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+                connections_.erase(fd);
+                ::close(fd);
+            }
+        }
+    }
+
+    /// @brief Send the pending response, then read and answer the
+    ///        complete requests, and re-arm the connection for what it
+    ///        waits for next
+    /// @return false if the connection is to be closed
+    bool serve(Connection& connection)
+    {
+        if (!flush(connection))
+            return false;
+        if (connection.sent == connection.out.size())
+        {
+            if (connection.closing)
+                return false;
+            if (!receive(connection))
+                return false;
+            while (answer(connection))
+                ;
+            auto& in = connection.in;
+            in.erase(in.begin(), in.begin() + connection.answered);
+            if (connection.scanned != 0)
+                connection.scanned -= connection.answered;
+            connection.answered = 0;
+            if (!flush(connection))
+                return false;
+            if (connection.closing
+             && connection.sent == connection.out.size())
+                return false;
+        }
+        auto events = (connection.sent < connection.out.size())
+            ? EPOLLOUT : EPOLLIN;
+        return watch(connection.fd, EPOLL_CTL_MOD, events | EPOLLONESHOT);
+    }
+
+    /// @brief Append what has arrived to the input buffer, up to
+    ///        max_request bytes: that holds any valid request, and a
+    ///        client writing faster than it is answered is then read
+    ///        again once the buffered requests are (level triggered)
+    /// @return false on end of file or error
+    static bool receive(Connection& connection)
+    {
+        auto& in = connection.in;
+        while (in.size() < QueryProtocol::max_request)
+        {
+            auto size = in.size();
+            in.resize(size + 64 * 1024);
+            auto n = ::read(connection.fd, in.data() + size
+                          , in.size() - size);
+            in.resize(size + std::max<ssize_t>(n, 0));
+            if (n > 0)
+                continue;
+            if (n < 0 && errno == EINTR)
+                continue;
+            return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+        return true;
+    }
+
+    /// @brief Send as much of the pending response as the socket takes
+    /// @return false on error
+    static bool flush(Connection& connection)
+    {
+        auto& out = connection.out;
+        while (connection.sent < out.size())
+        {
+            auto n = ::send(connection.fd, out.data() + connection.sent
+                          , out.size() - connection.sent
+                          , MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return true;
+            if (n <= 0)
+                return false;
+            connection.sent += n;
+        }
+        out.clear();
+        connection.sent = 0;
+        return true;
+    }
+
+    /// @brief Answer the first request of the input buffer into the
+    ///        output buffer if it has all arrived. A bad request is
+    ///        answered as soon as it is seen to be bad.
+    /// @return true if a request was answered and the next may be
+    bool answer(Connection& connection)
+    {
+        using Protocol = QueryProtocol;
+        auto& in = connection.in;
+        auto start = connection.answered;
+        Protocol::RequestHeader request;
+        if (connection.closing || in.size() - start < sizeof(request))
+            return false;
+        std::memcpy(&request, in.data() + start, sizeof(request));
+        bool valid = (request.op == Protocol::count
+                   || request.op == Protocol::locate)
+                  && request.patterns <= Protocol::max_patterns;
+
+        // check the patterns received since the last call
+        auto& pos = connection.scanned;
+        if (pos == 0)
+            pos = start + sizeof(request);
+        for (; valid && connection.patterns < request.patterns
+             ; connection.patterns++)
+        {
+            uint32_t length;
+            if (in.size() - pos < sizeof(length))
+                return false;
+            std::memcpy(&length, in.data() + pos, sizeof(length));
+            if (length > Protocol::max_length
+             || pos - start + sizeof(length) + length
+                    > Protocol::max_request)
+                valid = false;
+            else if (in.size() - pos - sizeof(length) < length)
+                return false;
+            else
+                pos += sizeof(length) + length;
+        }
+
+        auto& buf = connection.out;
+        Protocol::ResponseHeader response {
+            Protocol::ok, request.patterns};
+        if (!valid)
+        {
+            response = {Protocol::bad_request, 0};
+            Protocol::append(buf, response);
+            connection.closing = true;
+            return false;
+        }
+        Protocol::append(buf, response);
+        std::string pattern;
+        for (auto p = start + sizeof(request); p < pos; )
+        {
+            uint32_t length;
+            std::memcpy(&length, in.data() + p, sizeof(length));
+            p += sizeof(length);
+            pattern.assign(in.data() + p, length);
+            p += length;
+
+            if (request.op == Protocol::count)
+                Protocol::append(buf, uint64_t(index_.count(pattern)));
+            else
+            {
+                auto locations = index_.locate(pattern);
+                Protocol::append(buf, uint64_t(locations.size()));
+                for (auto location : locations)
+                    Protocol::append(buf, uint64_t(location));
+            }
+        }
+        connection.answered = pos;
+        connection.scanned = 0;
+        connection.patterns = 0;
+        return true;
+    }
+
+    void close_all()
+    {
+        for (auto fd : {listen_fd_, epoll_fd_, stop_[0], stop_[1]})
+            if (fd >= 0)
+                ::close(fd);
+        listen_fd_ = epoll_fd_ = stop_[0] = stop_[1] = -1;
+    }
+};
+
+/// @brief Client of a QueryServer, one connection answering one
+///        request at a time
+class QueryClient
+{
+    int fd_;
+
+  public:
+    /// @param path Socket path of the server
+    explicit QueryClient(const std::string& path)
+    {
+        auto addr = QueryProtocol::socket_address(path);
+        fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd_ < 0)
+            throw std::runtime_error("can not create socket");
+        if (::connect(fd_, reinterpret_cast<sockaddr*>(&addr)
+                    , sizeof(addr)) != 0)
+        {
+            ::close(fd_);
+            throw std::runtime_error("can not connect to " + path);
+        }
+    }
+
+    QueryClient(const QueryClient&) = delete;
+    QueryClient& operator=(const QueryClient&) = delete;
+
+    ~QueryClient()
+    { ::close(fd_); }
+
+    /// @brief Count the occurence of each pattern
+    template<class PATTERNS>
+    std::vector<uint64_t> count(const PATTERNS& patterns)
+    {
+        request(QueryProtocol::count, patterns);
+        std::vector<uint64_t> counts(patterns.size());
+        read(counts.data(), counts.size() * sizeof(uint64_t));
+        return counts;
+    }
+
+    /// @brief Locate all occurence of each pattern, in bwt order
+    template<class PATTERNS>
+    std::vector<std::vector<uint64_t>> locate(const PATTERNS& patterns)
+    {
+        request(QueryProtocol::locate, patterns);
+        std::vector<std::vector<uint64_t>> locations(patterns.size());
+        for (auto& hits : locations)
+        {
+            uint64_t n;
+            read(&n, sizeof(n));
+            hits.resize(n);
+            read(hits.data(), n * sizeof(uint64_t));
+        }
+        return locations;
+    }
+
+  private:
+    /// @brief Send a request and read the response header
+    template<class PATTERNS>
+    void request(QueryProtocol::Op op, const PATTERNS& patterns)
+    {
+        using Protocol = QueryProtocol;
+        std::vector<char> buf;
+        Protocol::append(buf, Protocol::RequestHeader {
+            op, uint32_t(patterns.size())});
+        for (const auto& pattern : patterns)
+        {
+            Protocol::append(buf, uint32_t(pattern.size()));
+            buf.insert(buf.end(), pattern.begin(), pattern.end());
+        }
+        if (!Protocol::write_full(fd_, buf.data(), buf.size()))
+            throw std::runtime_error("can not send request");
+
+        Protocol::ResponseHeader response;
+        read(&response, sizeof(response));
+        if (response.status != Protocol::ok
+         || response.results != patterns.size())
+            throw std::runtime_error("request rejected by server");
+    }
+
+    void read(void* buf, std::size_t size)
+    {
+        if (!QueryProtocol::read_full(fd_, buf, size))
+            throw std::runtime_error("connection closed by server");
+    }
+};
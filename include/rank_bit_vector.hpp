@@ -0,0 +1,211 @@
+#pragma once
+#include <cstdint>
+#include <algorithm>
+#include <cassert>
+#include <ostream>
+#include <stdexcept>
+#include "mapped_array.hpp"
+
+/// @brief Bit vector with constant time rank. Bits are stored in
+///        cache line blocks, each made of the number of ones before
+///        the block followed by 7 words of bits, so a rank reads one
+///        cache line and does at most 7 popcounts. Select is
+///        optional (init_select()): the block of every
+///        select_rate-th one and zero is sampled, and a select
+///        searches the blocks between two samples by their counts.
+class RankBitVector
+{
+  public:
+    static constexpr int         block_words = 8;
+    static constexpr int         bit_words   = block_words - 1;
+
+    /// @brief Bits per block
+    static constexpr std::size_t block_bits  = 64 * bit_words;
+
+    /// @brief Ones (and zeros) per select sample
+    static constexpr std::size_t select_rate = 512;
+
+  private:
+    MappedArray<uint64_t> blocks_;
+    std::size_t           size_ = 0;
+
+    /// @brief Block of the (j * select_rate)-th one and zero, empty
+    ///        unless init_select() is called
+    MappedArray<uint64_t> one_samples_;
+    MappedArray<uint64_t> zero_samples_;
+
+  public:
+    RankBitVector() = default;
+
+    /// @brief All zero bit vector of n bits, set bits by set() then
+    ///        call init_rank()
+    explicit RankBitVector(std::size_t n)
+        : size_(n)
+    {
+        // one extra block so that rank(size()) has its count
+        blocks_.resize((n / block_bits + 1) * block_words);
+    }
+
+    bool operator[](std::size_t i) const
+    {
+        return (word(i) >> (i % 64)) & 1;
+    }
+
+    /// @brief Set i-th bit. Bits of different blocks can be set by
+    ///        different threads.
+    void set(std::size_t i)
+    {
+        blocks_[i / block_bits * block_words + 1 + i % block_bits / 64]
+            |= uint64_t(1) << (i % 64);
+    }
+
+    /// @brief Fill the counts at block heads, once all bits are set
+    void init_rank()
+    {
+        uint64_t count = 0;
+        for (std::size_t b = 0; b < blocks_.size(); b += block_words)
+        {
+            blocks_[b] = count;
+            for (auto w = 1; w < block_words; w++)
+                count += __builtin_popcountll(blocks_[b + w]);
+        }
+    }
+
+    /// @brief Sample blocks for select() and select0(), once rank
+    ///        is initialized
+    void init_select()
+    {
+        one_samples_.clear();
+        zero_samples_.clear();
+        for (std::size_t b = 0; b * block_bits < size_; b++)
+        {
+            auto end = std::min((b + 1) * block_bits, size_);
+            auto ones_end = rank(end);
+            while (one_samples_.size() * select_rate < ones_end)
+                one_samples_.emplace_back(b);
+            while (zero_samples_.size() * select_rate < end - ones_end)
+                zero_samples_.emplace_back(b);
+        }
+    }
+
+    /// @brief Position of the k-th one (from 0), k < rank(size())
+    std::size_t select(std::size_t k) const
+    {
+        auto b = find_block(one_samples_, k
+          , [this](std::size_t b){ return ones_before(b); });
+        return b * block_bits + select_in_block(b, k - ones_before(b)
+          , [](uint64_t word){ return word; });
+    }
+
+    /// @brief Position of the k-th zero (from 0), k < size() -
+    ///        rank(size())
+    std::size_t select0(std::size_t k) const
+    {
+        auto b = find_block(zero_samples_, k
+          , [this](std::size_t b){ return zeros_before(b); });
+        return b * block_bits + select_in_block(b, k - zeros_before(b)
+          , [](uint64_t word){ return ~word; });
+    }
+
+    /// @brief Hint that [i] or rank(i) is coming, fetch its block
+    void prefetch(std::size_t i) const
+    {
+        __builtin_prefetch(blocks_.data() + i / block_bits * block_words);
+    }
+
+    /// @brief Number of ones in [0, i)
+    std::size_t rank(std::size_t i) const
+    {
+        auto block = blocks_.data() + i / block_bits * block_words;
+        auto offset = i % block_bits;
+        std::size_t count = block[0];
+        for (std::size_t w = 0; w < offset / 64; w++)
+            count += __builtin_popcountll(block[1 + w]);
+        if (offset % 64)
+            count += __builtin_popcountll(
+                block[1 + offset / 64]
+              & ((uint64_t(1) << (offset % 64)) - 1));
+        return count;
+    }
+
+    std::size_t size() const
+    { return size_; }
+
+    void save(std::ostream& os) const
+    {
+        save_pod(os, uint64_t(size_));
+        blocks_.save(os);
+        one_samples_.save(os);
+        zero_samples_.save(os);
+    }
+
+    void map(const char*& ptr, const char* end)
+    {
+        uint64_t size;
+        map_pod(ptr, end, size);
+        blocks_.map(ptr, end);
+        if (blocks_.size() != (size / block_bits + 1) * block_words)
+            throw std::runtime_error("corrupted index file");
+        one_samples_.map(ptr, end);
+        zero_samples_.map(ptr, end);
+        size_ = size;
+    }
+
+  private:
+    std::size_t ones_before(std::size_t b) const
+    { return blocks_[b * block_words]; }
+
+    std::size_t zeros_before(std::size_t b) const
+    { return b * block_bits - ones_before(b); }
+
+    /// @brief Last block with count_before(block) <= k, between the
+    ///        samples around k
+    template<class COUNT>
+    std::size_t find_block(
+        const MappedArray<uint64_t>& samples
+      , std::size_t k
+      , COUNT count_before
+    ) const
+    {
+        assert(k / select_rate < samples.size());
+        std::size_t lo = samples[k / select_rate];
+        std::size_t hi = (k / select_rate + 1 < samples.size())
+            ? samples[k / select_rate + 1]
+            : blocks_.size() / block_words - 1;
+        while (lo < hi)
+        {
+            auto mid = (lo + hi + 1) / 2;
+            if (count_before(mid) <= k)
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+        return lo;
+    }
+
+    /// @brief Offset in block b of the k-th set bit of the words
+    ///        transformed by f
+    template<class F>
+    std::size_t select_in_block(std::size_t b, std::size_t k, F f) const
+    {
+        auto block = blocks_.data() + b * block_words;
+        for (std::size_t w = 0; ; w++)
+        {
+            auto bits = f(block[1 + w]);
+            std::size_t count = __builtin_popcountll(bits);
+            if (k < count)
+            {
+                for (; k > 0; k--)
+                    bits &= bits - 1;
+                return w * 64 + __builtin_ctzll(bits);
+            }
+            k -= count;
+        }
+    }
+
+    uint64_t word(std::size_t i) const
+    {
+        return blocks_[i / block_bits * block_words
+                     + 1 + i % block_bits / 64];
+    }
+};
@@ -0,0 +1,167 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <utility>
+#include <algorithm>
+#include <vector>
+#include <stdexcept>
+#include "mapped_array.hpp"
+#include "packed_vector.hpp"
+#include "rank_bit_vector.hpp"
+
+/// @brief Record boundaries of a concatenated collection, mapping a
+///        position to its record and offset. The begins of the
+///        non-empty records form an Elias-Fano sequence: the low bits
+///        packed, the high bits in unary in a bit vector with select,
+///        about 2 + log(size / records) bits per record. The record of
+///        a position is found by a select0 on its high bits and a scan
+///        of the few begins sharing them, its begin by a select.
+class RecordMap
+{
+    /// @brief Bit i + (begin_i >> low_bits) set for the i-th begin
+    RankBitVector         upper_;
+
+    /// @brief Low bits of each begin
+    IntVector             lower_;
+
+    /// @brief Record id of each non-empty record, empty if no record
+    ///        is empty (ids are then the same)
+    MappedArray<uint64_t> ids_;
+
+    /// @brief Total length of the records
+    uint64_t              size_ = 0;
+
+    /// @brief Number of records, empty ones included
+    uint64_t              count_ = 0;
+
+  public:
+    RecordMap() = default;
+
+    /// @param lengths Length of each record, in concatenation order
+    explicit RecordMap(const std::vector<uint64_t>& lengths)
+        : count_(lengths.size())
+    {
+        bool has_empty = std::find(lengths.begin(), lengths.end(), 0)
+                      != lengths.end();
+        std::vector<uint64_t> begins;
+        for (std::size_t r = 0; r < lengths.size(); r++)
+        {
+            if (lengths[r] == 0)
+                continue;
+            begins.push_back(size_);
+            if (has_empty)
+                ids_.emplace_back(r);
+            size_ += lengths[r];
+        }
+
+        // low bits floor(log2(size / records)), at least 1
+        int low_bits = 1;
+        auto gap = begins.empty() ? 0 : size_ / begins.size();
+        while (low_bits < 63 && (gap >> (low_bits + 1)))
+            low_bits++;
+        lower_ = IntVector(begins.size(), low_bits);
+        upper_ = RankBitVector(begins.size() + (size_ >> low_bits) + 1);
+        for (std::size_t i = 0; i < begins.size(); i++)
+        {
+            lower_.set(i, begins[i]);
+            upper_.set(i + (begins[i] >> low_bits));
+        }
+        upper_.init_rank();
+        upper_.init_select();
+    }
+
+    /// @brief Number of records, empty ones included
+    std::size_t count() const
+    { return count_; }
+
+    /// @brief Total length of the records
+    uint64_t size() const
+    { return size_; }
+
+    /// @brief Record of a position and the offset in it
+    /// @param pos Position in the concatenation, < size()
+    std::pair<std::size_t, uint64_t> to_record(uint64_t pos) const
+    {
+        auto i = find(pos);
+        return std::make_pair(id(i), pos - begin(i));
+    }
+
+    /// @brief Length of a record
+    /// @param record Record id, < count()
+    uint64_t length(std::size_t record) const
+    {
+        std::size_t i = record;
+        if (!ids_.empty())
+        {
+            auto it = std::lower_bound(ids_.begin(), ids_.end(), record);
+            if (it == ids_.end() || *it != record)
+                return 0;
+            i = it - ids_.begin();
+        }
+        return (i + 1 < lower_.size() ? begin(i + 1) : size_) - begin(i);
+    }
+
+    /// @brief Record and offset of the match [pos, pos + len)
+    /// @return false if the match crosses the end of its record
+    bool locate(
+        uint64_t pos
+      , uint64_t len
+      , std::size_t& record
+      , uint64_t& offset
+    ) const
+    {
+        if (pos + len > size_)
+            return false;
+        auto i = find(pos);
+        if (i + 1 < lower_.size() && begin(i + 1) < pos + len)
+            return false;
+        record = id(i);
+        offset = pos - begin(i);
+        return true;
+    }
+
+    void save(std::ostream& os) const
+    {
+        save_pod(os, size_);
+        save_pod(os, count_);
+        upper_.save(os);
+        lower_.save(os);
+        ids_.save(os);
+    }
+
+    void map(const char*& ptr, const char* end)
+    {
+        map_pod(ptr, end, size_);
+        map_pod(ptr, end, count_);
+        upper_.map(ptr, end);
+        lower_.map(ptr, end);
+        ids_.map(ptr, end);
+        if (upper_.size() != lower_.size()
+                + (size_ >> lower_.width()) + 1)
+            throw std::runtime_error("corrupted index file");
+    }
+
+  private:
+    uint64_t begin(std::size_t i) const
+    {
+        return ((upper_.select(i) - i) << lower_.width()) | lower_[i];
+    }
+
+    std::size_t id(std::size_t i) const
+    { return ids_.empty() ? i : ids_[i]; }
+
+    /// @brief Last begin not after pos
+    std::size_t find(uint64_t pos) const
+    {
+        auto high = pos >> lower_.width();
+        auto low = pos & ((uint64_t(1) << lower_.width()) - 1);
+
+        // begins with smaller high bits precede the high-th zero
+        std::size_t i = (high == 0)
+            ? 0 : upper_.select0(high - 1) - (high - 1);
+        while (i + high < upper_.size() && upper_[i + high]
+            && lower_[i] <= low)
+            i++;
+        return i - 1;
+    }
+};
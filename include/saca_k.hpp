@@ -1,26 +1,70 @@
 #pragma once
 #include <type_traits>
 #include <algorithm>
+#include <memory>
+#include <vector>
+#include <stdexcept>
+#include "thread_pool.hpp"
+#include "packed_vector.hpp"
+#include "build_stats.hpp"
 
+/// @brief SA-IS with constant extra space (Nong's SACA-K). With more
+///        than one thread, the top level (where the input is the
+///        original seq and the most time is spent) induces block by
+///        block: threads fetch the preceding characters of a block
+///        and flush its buffered writes, while one thread walks the
+///        bucket cursors. Counting, LMS placement and naming run in
+///        parallel on every level. The result is the same as the
+///        sequential one.
 template<class SEQ, class SA>
 class SACA_K
 {
     using SaItr = typename SA::iterator;
     using Index = typename SA::value_type;
     using SignedIndex = std::make_signed_t<Index>;
-    const Index EMPTY { ((Index)1) << (sizeof(Index)*8-1) };
+
+    /// @brief Smallest negative element, the top bit of an element
+    ///        being its sign. Elements narrower than Index read back
+    ///        sign extended, so this compares equal to them.
+    const Index EMPTY { static_cast<Index>(Index(-1)
+        - (Index(1) << (element_bits<SA>() - 1)) + 1) };
+
+    /// @brief Number of threads, 1 for sequential
+    unsigned                     threads_ = 1;
+
+    /// @brief Number of sa entries induced per block
+    std::size_t                  block_size_;
+
+    /// @brief Only alive during build() when threads_ > 1
+    std::unique_ptr<ThreadPool>  pool_;
+
+    /// @brief Number of levels of the last build()
+    Index                        depth_ = 0;
 
   public:
-    SACA_K() = default;
+    /// @param threads Number of threads, 0 for all hardware threads
+    /// @param block_size Sa entries per induction block
+    explicit SACA_K(unsigned threads = 1, std::size_t block_size = 1 << 20)
+        : threads_(threads)
+        , block_size_(block_size)
+    {}
 
     void build(const SEQ& seq, SA& sa, Index k)
     {
-        return call_impl(
+        // positions and counters must stay below the sign bit
+        if (seq.size() >= (Index(1) << (element_bits<SA>() - 1)))
+            throw std::runtime_error("sequence too long for the SA type");
+        if (threads_ != 1)
+            pool_ = std::make_unique<ThreadPool>(threads_);
+        depth_ = 0;
+        call_impl(
             seq.begin()
           , sa.begin()
           , seq.size()
           , k
           , seq.size());
+        pool_.reset();
+        BuildStats::count("saca_k.depth", depth_);
     }
 
   // private:
@@ -37,12 +81,18 @@ class SACA_K
     )
     {
         // stage 1: reduce the problem by at least 1/2
+        depth_ = std::max<Index>(depth_, level + 1);
+        BuildStats::Phases phases(level);
+        phases.next("saca_k.reduce", 2 * uint64_t(k) * sizeof(Index));
         std::vector<Index> bkt(k), count(k);
         if (level == 0)
         {
             // count the number of each character
-            std::for_each(seq, seq+n,
-                [&count](auto& chr){ count[chr]++; });
+            if (pool_)
+                count_parallel(seq, count, n);
+            else
+                std::for_each(seq, seq+n,
+                    [&count](auto&& chr){ count[chr]++; });
 
             put_lms_substr0(seq, sa, bkt, count, n);
             induce_sal0(seq, sa, bkt, count, n, false);
@@ -62,7 +112,7 @@ class SACA_K
         // of SA. 2*n1 must be not larger than n (proveable)
         Index n1 = 0;
         std::for_each(sa, sa+n, 
-            [&n1, &sa](auto& sa_value)
+            [&n1, &sa](auto&& sa_value)
             {
                 if (static_cast<SignedIndex>(sa_value) > 0)
                     sa[n1++] = sa_value;
@@ -71,16 +121,25 @@ class SACA_K
         auto sa1 = sa; // sa1: the first n1 elements in sa
         auto s1 = sa + m - n1; // s1: the last n1 element in sa
         Index name_count = name_substr(seq, sa, s1, n, m, n1);
+        if (BuildStats::enabled())
+        {
+            auto prefix = "saca_k.level" + std::to_string(level) + ".";
+            BuildStats::count(prefix + "size", n);
+            BuildStats::count(prefix + "lms_size", n1);
+            BuildStats::count(prefix + "names", name_count);
+        }
 
         // stage 2: solve the reduced problem
         // recurse if names are not yet unique
+        phases.next("saca_k.recurse");
         if (name_count < n1)
             call_impl(s1, sa1, n1, 0, m-n1, level+1);
         else
             std::for_each(s1, s1+n1
-                , [&sa1, i = 0](auto& elem) mutable { sa1[elem] = i++; });
+                , [&sa1, i = 0](auto&& elem) mutable { sa1[elem] = i++; });
 
         // stage 3: induce SA(S) from SA(S1)
+        phases.next("saca_k.induce");
         get_sa_of_lms(seq, sa, s1, n, n1, level);
         if (level == 0)
         {
@@ -158,23 +217,16 @@ class SACA_K
         std::fill(sa+n1, sa+n, EMPTY);
 
         // scan to compute the interim s1
+        if (pool_)
+            return name_substr_parallel(seq, sa, s1, n, m, n1);
+
         Index name, name_counter = 0;
         Index pre_pos, pre_len = 0;
-        for (auto i = 0; i < n1; i++)
+        for (Index i = 0; i < n1; i++)
         {
-            auto diff = false;
             Index pos = sa[i];
             Index len = get_lms_len(seq, n, pos);
-            if (len != pre_len)
-                diff = true;
-            else
-                for (auto d = 0; d < len; d++)
-                    if (pos+d == n-1 || pre_pos+d == n-1 || 
-                        (seq[pos+d] != seq[pre_pos+d]))
-                    {
-                        diff = true;
-                        break;
-                    }
+            auto diff = substr_diff(seq, n, pos, len, pre_pos, pre_len);
 
             if (diff)
             {
@@ -190,6 +242,37 @@ class SACA_K
             sa[n1 + pos/2] = name;
         }
 
+        compact_s1(sa, s1, n, m, n1);
+        return name_counter;
+    }
+
+    template<class SEQ_ITR>
+    bool substr_diff(
+        const SEQ_ITR seq
+      , Index n
+      , Index pos
+      , Index len
+      , Index pre_pos
+      , Index pre_len
+    )
+    {
+        if (len != pre_len)
+            return true;
+        for (Index d = 0; d < len; d++)
+            if (pos+d == n-1 || pre_pos+d == n-1 || 
+                (seq[pos+d] != seq[pre_pos+d]))
+                return true;
+        return false;
+    }
+
+    void compact_s1(
+        SaItr sa
+      , SaItr s1
+      , Index n
+      , Index m
+      , Index n1
+    )
+    {
         // compact the interim s1 sparsely stored in sa[n1, n-1] into
         // sa[m-n1, m-1]
         for (auto i = n-1, j = m-1; i >= n1; i--)
@@ -201,15 +284,13 @@ class SACA_K
         bool pre_type, cur_type = true;
         for (auto i = n1-1; i > 0; i--) 
         {
-            auto ch = s1[i];
-            auto pre_ch = s1[i-1];
+            Index ch = s1[i];
+            Index pre_ch = s1[i-1];
             pre_type = (pre_ch < ch || (pre_ch == ch && cur_type));
             if (pre_type)
                 s1[i-1] += sa[s1[i-1]] - 1;
             cur_type = pre_type;
         }
-
-        return name_counter;
     }
 
     template<class SEQ_ITR>
@@ -222,6 +303,9 @@ class SACA_K
       , Index level
     )
     {
+        if (pool_)
+            return get_sa_of_lms_parallel(seq, sa, s1, n, n1, level);
+
         // put LMS into s1
         Index j = n1-1;
         s1[j--] = n-1;
@@ -237,7 +321,7 @@ class SACA_K
 
         // get suffix array of LMS
         std::for_each(sa, sa+n1
-          , [&s1](auto& sa_value){ 
+          , [&s1](auto&& sa_value){ 
           sa_value = s1[sa_value]; });
 
         // init sa[n1..n-1]
@@ -256,6 +340,9 @@ class SACA_K
       , Index n
     )
     {
+        if (pool_)
+            return put_lms_substr0_parallel(seq, sa, bkt, count, n);
+
         // find end of each bucket
         get_buckets(count, bkt, true);
 
@@ -285,9 +372,12 @@ class SACA_K
       , bool suffix
     )
     {
+        if (pool_)
+            return induce_sal0_parallel(seq, sa, bkt, count, n, suffix);
+
         get_buckets(count, bkt, false); // find the head of bucket
         bkt[0]++; // skip $
-        for (auto i = 0; i < n; i++)
+        for (Index i = 0; i < n; i++)
             if (sa[i] > 0)
             {
                 auto j = sa[i] - 1;
@@ -310,6 +400,9 @@ class SACA_K
       , bool suffix
     )
     {
+        if (pool_)
+            return induce_sas0_parallel(seq, sa, bkt, count, n, suffix);
+
         get_buckets(count, bkt, true); // find the end of bucket
         for (auto i = n-1; i > 0; i--)
             if (sa[i] > 0)
@@ -340,8 +433,10 @@ class SACA_K
         // put the suffix into their bucket
         for (auto i = n1-1; i > 0; i--)
         {
-            sa[ bkt[seq[sa[i]]]-- ] = sa[i];
+            // clear first, the suffix may be put back to slot i
+            Index j = sa[i];
             sa[i] = 0;
+            sa[ bkt[seq[j]]-- ] = j;
         }
         sa[0] = n-1; // set the single sentinel suffix
     }
@@ -440,12 +535,12 @@ class SACA_K
       , bool suffix
     )
     {
-        for (auto i = 0, step = 1; i < n; i += step, step = 1)
+        for (Index i = 0, step = 1; i < n; i += step, step = 1)
         {
             auto j = sa[i] - 1;
             if (static_cast<SignedIndex>(sa[i]) <= 0)
                 continue;
-            auto c = seq[j], c1 = seq[j+1];
+            Index c = seq[j], c1 = seq[j+1];
             bool is_L_type = (c >= c1);
             if (!is_L_type)
                 continue;
@@ -509,7 +604,7 @@ class SACA_K
 
         // scan to shift-left the items in each bucket 
         //   with its head being reused as a counter.
-        for (auto i = 1; i < n; i++)
+        for (Index i = 1; i < n; i++)
         {
             auto j = static_cast<SignedIndex>(sa[i]);
             if (j < 0 && j != EMPTY) // is sa[i] a counter?
@@ -533,7 +628,7 @@ class SACA_K
             auto j = sa[i]-1;
             if (static_cast<SignedIndex>(sa[i]) <= 0)
                 continue;
-            auto c = seq[j], c1 = seq[j+1];
+            Index c = seq[j], c1 = seq[j+1];
             bool is_s_type = (c < c1) || (c == c1 && c > i);
             if (!is_s_type)
                 continue;
@@ -622,7 +717,7 @@ class SACA_K
         Index pos, cur, pre = -1;
         for (auto i = n1-1; i > 0; i--)
         {
-            auto j = sa[i];
+            Index j = sa[i];
             sa[i] = EMPTY;
             cur = seq[j];
             if (cur != pre)
@@ -633,4 +728,423 @@ class SACA_K
             sa[pos--] = j;
         }
     }
+
+    ////////////////////////////////////////////////
+    // Parallel steps, only called when pool_ is set
+    ////////////////////////////////////////////////
+
+    /// @brief Type of seq[i] (S-type is true), found by looking ahead
+    ///        to the first different character
+    template<class SEQ_ITR>
+    bool type_at(const SEQ_ITR seq, Index n, Index i)
+    {
+        if (i == n-1)
+            return true;
+        while (i < n-2 && seq[i] == seq[i+1])
+            i++;
+        if (i == n-2) // seq[n-2] must be L-type
+            return false;
+        return seq[i] < seq[i+1];
+    }
+
+    /// @brief Call f(i) for every LMS i in [begin, end), right to
+    ///        left, where 0 < begin and end <= n-1
+    template<class SEQ_ITR, class F>
+    void for_each_lms(
+        const SEQ_ITR seq
+      , Index n
+      , Index begin
+      , Index end
+      , F f
+    )
+    {
+        bool pre_type, cur_type = type_at(seq, n, end-1);
+        for (auto i = end-1; i >= begin; i--)
+        {
+            pre_type = (seq[i-1] < seq[i] || 
+                (seq[i-1] == seq[i] && cur_type));
+            if (cur_type && !pre_type)
+                f(i);
+            cur_type = pre_type;
+        }
+    }
+
+    template<class SEQ_ITR>
+    void count_parallel(
+        const SEQ_ITR seq
+      , std::vector<Index>& count
+      , Index n
+    )
+    {
+        std::vector<std::vector<Index>> local(
+            pool_->size(), std::vector<Index>(count.size()));
+        pool_->parallel_for(n,
+            [seq, &local](auto begin, auto end, auto tid)
+            {
+                for (auto i = begin; i < end; i++)
+                    local[tid][seq[i]]++;
+            });
+        for (const auto& part : local)
+            for (std::size_t c = 0; c < count.size(); c++)
+                count[c] += part[c];
+    }
+
+    /// @brief Chunk the LMS in [1, n-1) by thread. Count them per
+    ///        chunk, then call place(i, cursors) for each LMS in its
+    ///        chunk (right to left), where cursors[c] is where the
+    ///        sequential right-to-left scan would put the first LMS
+    ///        of the chunk starting with c (key(i) gives c).
+    /// @param cursors Start cursors of the whole scan
+    template<class SEQ_ITR, class KEY, class PLACE>
+    void place_lms_parallel(
+        const SEQ_ITR seq
+      , Index n
+      , std::vector<Index> cursors
+      , KEY key
+      , PLACE place
+    )
+    {
+        auto threads = pool_->size();
+        std::vector<std::vector<Index>> local(
+            threads, std::vector<Index>(cursors.size()));
+        pool_->parallel_for(n-2,
+            [this, seq, n, &key, &local](auto begin, auto end, auto tid)
+            {
+                for_each_lms(seq, n, begin+1, end+1,
+                    [&](auto i){ local[tid][key(i)]++; });
+            });
+
+        // the rightmost chunk goes first
+        for (auto tid = threads; tid-- > 0; )
+            for (std::size_t c = 0; c < cursors.size(); c++)
+            {
+                auto cnt = local[tid][c];
+                local[tid][c] = cursors[c];
+                cursors[c] -= cnt;
+            }
+
+        pool_->parallel_for(n-2,
+            [this, seq, n, &key, &place, &local]
+            (auto begin, auto end, auto tid)
+            {
+                auto& cur = local[tid];
+                for_each_lms(seq, n, begin+1, end+1,
+                    [&](auto i){ place(i, cur[key(i)]--); });
+            });
+    }
+
+    template<class SEQ_ITR>
+    void put_lms_substr0_parallel(
+        const SEQ_ITR seq
+      , SaItr sa
+      , std::vector<Index>& bkt
+      , std::vector<Index>& count
+      , Index n
+    )
+    {
+        get_buckets(count, bkt, true);
+        pool_->parallel_for(n,
+            [sa](auto begin, auto end, auto)
+            { std::fill(sa+begin, sa+end, 0); });
+
+        place_lms_parallel(seq, n, bkt
+          , [seq](auto i){ return seq[i]; }
+          , [sa](auto i, auto pos){ sa[pos] = i; });
+
+        sa[0] = n-1; // set the single sentinel LMS substr
+    }
+
+    template<class SEQ_ITR>
+    void get_sa_of_lms_parallel(
+        const SEQ_ITR seq
+      , SaItr sa
+      , SaItr s1
+      , Index n
+      , Index n1
+      , Index level
+    )
+    {
+        // put LMS into s1
+        s1[n1-1] = n-1;
+        place_lms_parallel(seq, n, std::vector<Index>(1, n1-2)
+          , [](auto){ return 0; }
+          , [s1](auto i, auto pos){ s1[pos] = i; });
+
+        // get suffix array of LMS
+        pool_->parallel_for(n1,
+            [sa, s1](auto begin, auto end, auto)
+            {
+                for (auto i = begin; i < end; i++)
+                    sa[i] = s1[sa[i]];
+            });
+
+        // init sa[n1..n-1] (s1 is in there)
+        auto fill = level ? EMPTY : 0;
+        pool_->parallel_for(n - n1,
+            [sa, n1, fill](auto begin, auto end, auto)
+            { std::fill(sa+n1+begin, sa+n1+end, fill); });
+    }
+
+    /// @brief Same as name_substr(). Threads flag where a new name
+    ///        starts, then write names and name counts of their chunk.
+    template<class SEQ_ITR>
+    Index name_substr_parallel(
+        const SEQ_ITR seq
+      , SaItr sa
+      , SaItr s1
+      , Index n
+      , Index m
+      , Index n1
+    )
+    {
+        auto threads = pool_->size();
+        // chunks are aligned to words of the flags
+        std::vector<uint64_t> diff((n1 + 63) / 64);
+        auto is_diff = [&diff](std::size_t i)
+        { return (diff[i / 64] >> (i % 64)) & 1; };
+
+        pool_->parallel_for(n,
+            [this, sa, n1](auto begin, auto end, auto)
+            { std::fill(sa + std::max<std::size_t>(begin, n1)
+                      , sa + std::max<std::size_t>(end, n1), EMPTY); });
+
+        pool_->parallel_for(n1,
+            [this, seq, sa, n, &diff](auto begin, auto end, auto)
+            {
+                Index pre_pos = 0, pre_len = 0;
+                if (begin != 0)
+                {
+                    pre_pos = sa[begin-1];
+                    pre_len = get_lms_len(seq, n, pre_pos);
+                }
+                for (auto i = begin; i < end; i++)
+                {
+                    Index pos = sa[i];
+                    Index len = get_lms_len(seq, n, pos);
+                    if (substr_diff(seq, n, pos, len, pre_pos, pre_len))
+                        diff[i / 64] |= uint64_t(1) << (i % 64);
+                    pre_pos = pos;
+                    pre_len = len;
+                }
+            }, 64);
+
+        // name (index of the latest new name) at each chunk begin
+        // and first new name after each chunk
+        std::vector<Index> first(threads + 1, n1), last(threads + 1, 0);
+        std::vector<Index> name_count(threads, 0);
+        pool_->parallel_for(n1,
+            [&](auto begin, auto end, auto tid)
+            {
+                for (auto i = begin; i < end; i++)
+                    if (is_diff(i))
+                    {
+                        if (first[tid] == n1)
+                            first[tid] = i;
+                        last[tid + 1] = i;
+                        name_count[tid]++;
+                    }
+            }, 64);
+        for (std::size_t tid = 0; tid < threads; tid++)
+            if (first[tid] == n1)
+                last[tid + 1] = last[tid];
+        for (auto tid = threads; tid-- > 0; )
+            if (first[tid] == n1)
+                first[tid] = first[tid + 1];
+
+        pool_->parallel_for(n1,
+            [&, sa, n1](auto begin, auto end, auto tid)
+            {
+                auto name = last[tid];
+                for (auto i = begin; i < end; i++)
+                {
+                    if (is_diff(i))
+                        name = i;
+                    sa[n1 + sa[i]/2] = name;
+                }
+            }, 64);
+
+        // count each name, sa[0..n1-1] is not read any more
+        pool_->parallel_for(n1,
+            [&, sa](auto begin, auto end, auto tid)
+            {
+                Index next = first[tid + 1];
+                for (auto i = end; i-- > begin; )
+                    if (is_diff(i))
+                    {
+                        sa[i] = next - i;
+                        next = i;
+                    }
+            }, 64);
+
+        compact_s1(sa, s1, n, m, n1);
+        Index name_counter = 0;
+        for (auto cnt : name_count)
+            name_counter += cnt;
+        return name_counter;
+    }
+
+    /// @brief Same as induce_sal0(), one block of sa at a time.
+    ///        Threads fetch the preceding character of every filled
+    ///        entry of the block, then the bucket cursors are walked
+    ///        sequentially. Writes landing in the block are made at
+    ///        once (they are read later in this block), the others are
+    ///        buffered and flushed by threads.
+    template<class SEQ_ITR>
+    void induce_sal0_parallel(
+        const SEQ_ITR seq
+      , SaItr sa
+      , std::vector<Index>& bkt
+      , std::vector<Index>& count
+      , Index n
+      , bool suffix
+    )
+    {
+        get_buckets(count, bkt, false); // find the head of bucket
+        bkt[0]++; // skip $
+
+        // state of a prefetched entry
+        enum : uint8_t { UNKNOWN, INDUCE, SKIP };
+        std::vector<uint8_t> state(block_size_);
+        std::vector<Index> chr(block_size_);
+        std::vector<std::pair<Index, Index>> writes;
+
+        for (Index b = 0; b < n; b += block_size_)
+        {
+            Index e = std::min<std::size_t>(n, b + block_size_);
+            pool_->parallel_for(writes.size(),
+                [sa, &writes](auto begin, auto end, auto)
+                {
+                    for (auto w = begin; w < end; w++)
+                        sa[writes[w].first] = writes[w].second;
+                });
+            writes.clear();
+
+            pool_->parallel_for(e - b,
+                [&, seq, sa, b](auto begin, auto end, auto)
+                {
+                    for (auto k = begin; k < end; k++)
+                    {
+                        state[k] = UNKNOWN;
+                        Index j = sa[b+k];
+                        if (j > 0)
+                        {
+                            j--;
+                            chr[k] = seq[j];
+                            state[k] = 
+                                (seq[j] >= seq[j+1]) ? INDUCE : SKIP;
+                        }
+                    }
+                });
+
+            for (auto i = b; i < e; i++)
+            {
+                auto k = i - b;
+                if (state[k] == UNKNOWN && sa[i] > 0)
+                {
+                    auto j = sa[i] - 1;
+                    chr[k] = seq[j];
+                    state[k] = (seq[j] >= seq[j+1]) ? INDUCE : SKIP;
+                }
+                if (state[k] != INDUCE)
+                    continue;
+
+                Index j = sa[i] - 1;
+                Index pos = bkt[chr[k]]++;
+                if (pos < e)
+                {
+                    sa[pos] = j;
+                    state[pos - b] = UNKNOWN;
+                }
+                else
+                    writes.emplace_back(pos, j);
+                if (!suffix && i>0)
+                    sa[i] = 0;
+            }
+        }
+        for (const auto& w : writes)
+            sa[w.first] = w.second;
+    }
+
+    /// @brief Same as induce_sas0(), block by block from the right,
+    ///        see induce_sal0_parallel()
+    template<class SEQ_ITR>
+    void induce_sas0_parallel(
+        const SEQ_ITR seq
+      , SaItr sa
+      , std::vector<Index>& bkt
+      , std::vector<Index>& count
+      , Index n
+      , bool suffix
+    )
+    {
+        get_buckets(count, bkt, true); // find the end of bucket
+
+        // state of a prefetched entry, EQUAL is decided by the cursor
+        enum : uint8_t { UNKNOWN, INDUCE, EQUAL, SKIP };
+        std::vector<uint8_t> state(block_size_);
+        std::vector<Index> chr(block_size_);
+        std::vector<std::pair<Index, Index>> writes;
+        auto classify = [seq](Index j)
+        {
+            return (seq[j] < seq[j+1]) ? INDUCE 
+                 : (seq[j] == seq[j+1]) ? EQUAL : SKIP;
+        };
+
+        // blocks cover [1, n), sa[0] is $ which induces no S-type
+        for (Index e = n; e > 1; )
+        {
+            Index b = (std::size_t(e - 1) > block_size_)
+                    ? e - block_size_ : 1;
+            pool_->parallel_for(writes.size(),
+                [sa, &writes](auto begin, auto end, auto)
+                {
+                    for (auto w = begin; w < end; w++)
+                        sa[writes[w].first] = writes[w].second;
+                });
+            writes.clear();
+
+            pool_->parallel_for(e - b,
+                [&, seq, sa, b](auto begin, auto end, auto)
+                {
+                    for (auto k = begin; k < end; k++)
+                    {
+                        state[k] = UNKNOWN;
+                        Index j = sa[b+k];
+                        if (j > 0)
+                        {
+                            chr[k] = seq[j-1];
+                            state[k] = classify(j-1);
+                        }
+                    }
+                });
+
+            for (auto i = e-1; i >= b; i--)
+            {
+                auto k = i - b;
+                if (state[k] == UNKNOWN && sa[i] > 0)
+                {
+                    chr[k] = seq[sa[i]-1];
+                    state[k] = classify(sa[i]-1);
+                }
+                if (state[k] == SKIP || state[k] == UNKNOWN ||
+                    (state[k] == EQUAL && bkt[chr[k]] >= i))
+                    continue;
+
+                Index j = sa[i] - 1;
+                Index pos = bkt[chr[k]]--;
+                if (pos >= b)
+                {
+                    sa[pos] = j;
+                    state[pos - b] = UNKNOWN;
+                }
+                else
+                    writes.emplace_back(pos, j);
+                if (!suffix)
+                    sa[i] = 0;
+            }
+            e = b;
+        }
+        for (const auto& w : writes)
+            sa[w.first] = w.second;
+    }
 };
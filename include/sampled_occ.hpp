@@ -0,0 +1,155 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include "mapped_array.hpp"
+#include "packed_vector.hpp"
+#include "thread_pool.hpp"
+
+/// @brief Occ backend storing the packed bwt plus a full count
+///        array every sample_rate characters. A query scans at most
+///        sample_rate/2 characters from the nearest sample.
+template<typename INDEX, int BITS>
+class SampledOcc
+{
+    using CTableType   = std::array<INDEX, (1 << BITS)>;
+    using OccTableType = MappedArray<CTableType>;
+
+    /// @brief bwt of the orignal seq, stored as alphabet rank
+    PackedVector<BITS> bwt_;
+
+    /// @brief Sampled occurence of each alphabet in bwt
+    OccTableType       occ_table_;
+
+    /// @brief The index of $(sentinal) in bwt
+    INDEX              primary_index_;
+
+    /// @brief Sample rate, valid value are 2^n, n>=0
+    INDEX              sample_rate_;
+
+  public:
+    /// @brief Tag stored in index files to detect backend mismatch
+    static constexpr uint32_t type_id = 1;
+
+    SampledOcc() = default;
+
+    /// @param bwt Bwt as alphabet rank, any value at primary_index
+    /// @param primary_index The index of $ in bwt
+    /// @param sample_rate Sample rate, valid value are 2^n, n>=0
+    /// @param threads Number of threads building the samples
+    SampledOcc(PackedVector<BITS> bwt, INDEX primary_index
+             , INDEX sample_rate, unsigned threads = 1)
+        : bwt_(std::move(bwt))
+        , primary_index_(primary_index)
+        , sample_rate_(sample_rate)
+    {
+        // Sample s+1 counts bwt[0, (s+1)*sample_rate). Count each
+        // interval on its own into sample s+1 and chunk by chunk,
+        // then sum them up.
+        std::size_t intervals = bwt_.size() / sample_rate_;
+        occ_table_.resize(intervals + 1);
+
+        ThreadPool pool(threads);
+        std::vector<CTableType> chunk_count(pool.size() + 1);
+        pool.parallel_for(intervals,
+            [this, &chunk_count](auto begin, auto end, auto tid)
+            {
+                for (auto s = begin; s < end; s++)
+                {
+                    auto& count = occ_table_[s + 1];
+                    for (auto i = s * sample_rate_
+                            ; i < (s + 1) * sample_rate_; i++)
+                        if (i != primary_index_)
+                            count[bwt_[i]]++;
+                    for (std::size_t c = 0; c < count.size(); c++)
+                        chunk_count[tid + 1][c] += count[c];
+                }
+            });
+
+        for (std::size_t tid = 1; tid < chunk_count.size(); tid++)
+            for (std::size_t c = 0; c < chunk_count[tid].size(); c++)
+                chunk_count[tid][c] += chunk_count[tid - 1][c];
+        pool.parallel_for(intervals,
+            [this, &chunk_count](auto begin, auto end, auto tid)
+            {
+                auto count = chunk_count[tid];
+                for (auto s = begin; s < end; s++)
+                    for (std::size_t c = 0; c < count.size(); c++)
+                        occ_table_[s + 1][c] = count[c] += 
+                            occ_table_[s + 1][c];
+            });
+    }
+
+    /// @brief Get occurence of character c uptile bwt index i
+    /// @param i Bwt index
+    /// @param c Rank of character
+    /// @return Number of occurence
+    INDEX occ(INDEX i, INDEX c) const
+    {
+        auto occ_lower_index = i / sample_rate_;
+        auto occ_upper_index = occ_lower_index + 1;
+        auto lower_offset = i & (sample_rate_ - 1);
+        INDEX c_count = 0;
+
+        if (lower_offset <= sample_rate_ / 2 ||
+            std::size_t(occ_upper_index) == occ_table_.size())
+        {
+            auto lower_index = occ_lower_index * sample_rate_;
+            for (auto j = lower_index; j < i; j++)
+                if (bwt_[j] == c && j != primary_index_)
+                    c_count++;
+
+            return occ_table_[occ_lower_index][c] + c_count;
+        }
+        else
+        {
+            auto upper_index = occ_upper_index * sample_rate_;
+            for (auto j = i; j < upper_index; j++)
+                if (bwt_[j] == c && j != primary_index_)
+                    c_count++;
+
+            return occ_table_[occ_upper_index][c] - c_count;
+        }
+    }
+
+    /// @brief Hint that occ(i, c) or [i] is coming, fetch the nearest
+    ///        samples and the bwt word of i into cache
+    void prefetch(INDEX i) const
+    {
+        auto sample = i / sample_rate_;
+        __builtin_prefetch(occ_table_.data() + sample);
+        if (sample + 1 < occ_table_.size())
+            __builtin_prefetch(occ_table_.data() + sample + 1);
+        __builtin_prefetch(bwt_.words().data() 
+                         + i / PackedVector<BITS>::per_word);
+    }
+
+    /// @brief Rank of the i-th character in bwt
+    INDEX operator[](INDEX i) const
+    { return bwt_[i]; }
+
+    std::size_t size() const
+    { return bwt_.size(); }
+
+    void save(std::ostream& os) const
+    {
+        save_pod(os, uint64_t(primary_index_));
+        save_pod(os, uint64_t(sample_rate_));
+        bwt_.save(os);
+        occ_table_.save(os);
+    }
+
+    void map(const char*& ptr, const char* end)
+    {
+        uint64_t primary_index, sample_rate;
+        map_pod(ptr, end, primary_index);
+        map_pod(ptr, end, sample_rate);
+        primary_index_ = primary_index;
+        sample_rate_ = sample_rate;
+        bwt_.map(ptr, end);
+        occ_table_.map(ptr, end);
+    }
+};
+
+template<typename INDEX, int BITS>
+constexpr uint32_t SampledOcc<INDEX, BITS>::type_id;
@@ -0,0 +1,360 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <string>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include <sys/mman.h>
+#include "mapped_array.hpp"
+#include "thread_pool.hpp"
+
+/// @brief Byte to output code table for reading DNA. Bytes are either
+///        a code, skipped (line breaks and spaces) or other (N and
+///        IUPAC codes), which are replaced by a pseudo random base.
+struct DnaEncoding
+{
+    static constexpr uint8_t skip  = 0xFF;
+    static constexpr uint8_t other = 0xFE;
+
+    uint8_t code[256];
+
+    /// @brief Codes of A, C, G, T
+    uint8_t base[4];
+
+    /// @brief Code of $ appended at the end, that of A (the smallest)
+    uint8_t sentinel;
+};
+
+/// @brief Encoding writing a, c, g, t for A, C, G, T (either case),
+///        e.g. 0, 1, 2, 3 for SACA_K or 'A', 'C', 'G', 'T' for
+///        FmIndex with DnaAlphabet
+constexpr DnaEncoding make_dna_encoding(
+    uint8_t a, uint8_t c, uint8_t g, uint8_t t)
+{
+    DnaEncoding encoding {};
+    for (auto i = 0; i < 256; i++)
+        encoding.code[i] = DnaEncoding::other;
+    encoding.code['\n'] = encoding.code['\r'] = DnaEncoding::skip;
+    encoding.code[' '] = encoding.code['\t'] = DnaEncoding::skip;
+    encoding.code['A'] = encoding.code['a'] = a;
+    encoding.code['C'] = encoding.code['c'] = c;
+    encoding.code['G'] = encoding.code['g'] = g;
+    encoding.code['T'] = encoding.code['t'] = t;
+    encoding.base[0] = a;
+    encoding.base[1] = c;
+    encoding.base[2] = g;
+    encoding.base[3] = t;
+    encoding.sentinel = a;
+    return encoding;
+}
+
+/// @brief A record of a sequence file and where it is in the
+///        concatenated sequence
+struct SequenceRecord
+{
+    /// @brief Header up to the first space, empty for plain text
+    std::string name;
+    uint64_t    begin;
+    uint64_t    length;
+};
+
+/// @brief Sequence file read into one encoded sequence, the records
+///        concatenated and $ appended. FASTA (multi-line, '>'
+///        headers), FASTQ (4 lines per record) and plain text (every
+///        line is sequence) are detected by the first character. The
+///        file is memory mapped, record boundaries found by memchr and
+///        the bodies encoded in parallel by a lookup table, in pieces
+///        whose output offsets come from a first counting pass. Bases
+///        other than ACGT are replaced by a hash of their position, so
+///        the result does not depend on the number of threads.
+class SequenceFile
+{
+    /// @brief Bytes of record body encoded as one task
+    static constexpr std::size_t piece_size = 1 << 20;
+
+    /// @brief Contiguous part of a record body in the file
+    struct Piece
+    {
+        const char* begin;
+        const char* end;
+        uint64_t    out;    // kept bytes before the piece
+        std::size_t record;
+    };
+
+    std::vector<char>           seq_;
+    std::vector<SequenceRecord> records_;
+
+  public:
+    /// @param path FASTA, FASTQ or plain sequence file
+    /// @param encoding Output code of every byte
+    /// @param threads Number of threads, 0 for all hardware threads
+    SequenceFile(
+        const std::string& path
+      , const DnaEncoding& encoding
+      , unsigned threads = 1
+    )
+    {
+        MmapFile file(path);
+        const char* ptr = file.data();
+        const char* end = ptr + file.size();
+        if (ptr)
+            ::madvise(const_cast<char*>(ptr), file.size()
+                    , MADV_SEQUENTIAL);
+
+        std::vector<Piece> pieces;
+        auto add_body = [this, &pieces](const char* begin, const char* end)
+        {
+            for (; begin < end; begin += piece_size)
+                pieces.push_back({begin
+                  , (std::size_t(end - begin) > piece_size)
+                        ? begin + piece_size : end
+                  , 0, records_.size() - 1});
+        };
+
+        while (ptr < end && is_space(*ptr))
+            ptr++;
+        if (ptr < end && *ptr == '>')
+            parse_fasta(ptr, end, add_body);
+        else if (ptr < end && *ptr == '@')
+            parse_fastq(ptr, end, add_body);
+        else if (ptr < end)
+        {
+            records_.push_back({"", 0, 0});
+            add_body(ptr, end);
+        }
+
+        // count kept bytes of each piece, then their output offsets
+        ThreadPool pool(threads);
+        pool.parallel_for(pieces.size(),
+            [&pieces, &encoding](auto begin, auto end, auto)
+            {
+                for (auto p = begin; p < end; p++)
+                    pieces[p].out = count_kept(pieces[p], encoding);
+            });
+        uint64_t total = 0;
+        for (auto& piece : pieces)
+        {
+            auto kept = piece.out;
+            piece.out = total;
+            records_[piece.record].length += kept;
+            total += kept;
+        }
+        for (std::size_t r = 1; r < records_.size(); r++)
+            records_[r].begin =
+                records_[r-1].begin + records_[r-1].length;
+
+        seq_.resize(total + 1);
+        pool.parallel_for(pieces.size(),
+            [this, &pieces, &encoding](auto begin, auto end, auto)
+            {
+                for (auto p = begin; p < end; p++)
+                    encode(pieces[p], encoding);
+            });
+        seq_[total] = encoding.sentinel;
+    }
+
+    /// @brief Encoded sequence, $ at the end
+    std::vector<char>& seq()
+    { return seq_; }
+
+    const std::vector<char>& seq() const
+    { return seq_; }
+
+    const std::vector<SequenceRecord>& records() const
+    { return records_; }
+
+  private:
+    static bool is_space(char c)
+    {
+        return c == '\n' || c == '\r' || c == ' ' || c == '\t';
+    }
+
+    /// @brief End of the line at ptr (its '\n' or end)
+    static const char* line_end(const char* ptr, const char* end)
+    {
+        auto found = static_cast<const char*>(
+            std::memchr(ptr, '\n', end - ptr));
+        return found ? found : end;
+    }
+
+    /// @brief Record name from a header line without its marker
+    static std::string header_name(const char* ptr, const char* end)
+    {
+        auto name_end = std::find_if(ptr, end,
+            [](char c){ return is_space(c); });
+        return std::string(ptr, name_end);
+    }
+
+    template<class ADD_BODY>
+    void parse_fasta(const char* ptr, const char* end, ADD_BODY add_body)
+    {
+        // ptr is at a '>', which can not occur in a body
+        while (ptr < end)
+        {
+            auto header_end = line_end(ptr, end);
+            records_.push_back({header_name(ptr + 1, header_end), 0, 0});
+            auto body = std::min(header_end + 1, end);
+            auto next = body;
+            while (true)
+            {
+                next = static_cast<const char*>(
+                    std::memchr(next, '>', end - next));
+                if (!next || next[-1] == '\n')
+                    break;
+                next++;
+            }
+            if (!next)
+                next = end;
+            add_body(body, next);
+            ptr = next;
+        }
+    }
+
+    template<class ADD_BODY>
+    void parse_fastq(const char* ptr, const char* end, ADD_BODY add_body)
+    {
+        while (ptr < end)
+        {
+            if (*ptr != '@')
+                throw std::runtime_error("malformed FASTQ record");
+            auto header_end = line_end(ptr, end);
+            records_.push_back({header_name(ptr + 1, header_end), 0, 0});
+            auto body = std::min(header_end + 1, end);
+            auto body_end = line_end(body, end);
+            auto plus = std::min(body_end + 1, end);
+            if (plus == end || *plus != '+')
+                throw std::runtime_error("malformed FASTQ record");
+            auto quality = std::min(line_end(plus, end) + 1, end);
+            add_body(body, body_end);
+
+            ptr = std::min(line_end(quality, end) + 1, end);
+            while (ptr < end && is_space(*ptr))
+                ptr++;
+        }
+    }
+
+    static uint64_t count_kept(const Piece& piece, const DnaEncoding& encoding)
+    {
+        uint64_t kept = 0;
+        for (auto p = piece.begin; p < piece.end; p++)
+            kept += encoding.code[static_cast<uint8_t>(*p)]
+                 != DnaEncoding::skip;
+        return kept;
+    }
+
+    void encode(const Piece& piece, const DnaEncoding& encoding)
+    {
+        auto out = piece.out;
+        for (auto p = piece.begin; p < piece.end; p++)
+        {
+            auto code = encoding.code[static_cast<uint8_t>(*p)];
+            if (code == DnaEncoding::skip)
+                continue;
+            if (code == DnaEncoding::other)
+                code = encoding.base[
+                    (out * 0x9E3779B97F4A7C15ull) >> 62];
+            seq_[out++] = code;
+        }
+    }
+};
+
+/// @brief Streaming reader of FASTA, FASTQ or plain (one sequence per
+///        line) records, detected by the first character as in
+///        SequenceFile, for query files and pipes which are read once.
+///        Sequences are returned as read, line breaks removed.
+class SequenceReader
+{
+    std::istream& is_;
+
+    /// @brief Next header line of a FASTA file, empty at the end
+    std::string   header_;
+
+    /// @brief '>' FASTA, '@' FASTQ, 0 plain, set by the first record
+    char          format_ = 0;
+    bool          started_ = false;
+
+  public:
+    explicit SequenceReader(std::istream& is)
+        : is_(is)
+    {}
+
+    /// @brief Read the next record
+    /// @param name Header up to the first space, empty for plain text
+    /// @return false at the end of the input
+    bool next(std::string& name, std::string& seq)
+    {
+        name.clear();
+        seq.clear();
+        std::string line;
+        if (!started_ || format_ != '>')
+        {
+            if (!next_line(line))
+                return false;
+            if (!started_)
+                format_ = (line[0] == '>' || line[0] == '@') ? line[0] : 0;
+            started_ = true;
+            if (format_ == 0)
+            {
+                seq = line;
+                return true;
+            }
+            header_ = line;
+        }
+        if (header_.empty())
+            return false;
+        name = header_name(header_);
+
+        if (format_ == '@')
+        {
+            std::string plus;
+            if (header_[0] != '@' || !std::getline(is_, seq)
+             || !std::getline(is_, plus) || plus.empty() || plus[0] != '+'
+             || !std::getline(is_, line))
+                throw std::runtime_error("malformed FASTQ record");
+            trim_end(seq);
+            return true;
+        }
+
+        header_.clear();
+        while (std::getline(is_, line))
+        {
+            trim_end(line);
+            if (!line.empty() && line[0] == '>')
+            {
+                header_ = line;
+                break;
+            }
+            seq += line;
+        }
+        return true;
+    }
+
+  private:
+    /// @brief Next non-blank line
+    bool next_line(std::string& line)
+    {
+        while (std::getline(is_, line))
+        {
+            trim_end(line);
+            if (!line.empty())
+                return true;
+        }
+        return false;
+    }
+
+    static void trim_end(std::string& line)
+    {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' '
+                              || line.back() == '\t'))
+            line.pop_back();
+    }
+
+    static std::string header_name(const std::string& header)
+    {
+        auto end = header.find_first_of(" \t", 1);
+        return header.substr(1, end == std::string::npos ? end : end - 1);
+    }
+};
@@ -0,0 +1,149 @@
+#pragma once
+#include <string>
+#include <utility>
+#include <vector>
+#include "fm_index.hpp"
+
+/// @brief Fm-index searching both strands of DNA records: one FmIndex
+///        of the records followed by their reverse complements, so a
+///        single backward search of a pattern finds it on the forward
+///        strand and, as the reverse complement, on the reverse one.
+///        Hits in a reverse complement record are mapped back to the
+///        forward coordinates of the record. Its size is that of an
+///        FmIndex of twice the records, a search costs one search.
+///        Characters other than ACGT are taken as A (see DnaAlphabet)
+///        on both strands.
+/// @tparam SEQ, INDEX, SORTER, OCC, INDEX_VECTOR See FmIndex
+template<
+    typename SEQ
+  , typename INDEX
+  , template<typename, typename> typename SORTER
+  , template<typename, int> typename OCC = BlockOcc
+  , typename INDEX_VECTOR = std::vector<INDEX>
+>
+class StrandFmIndex
+{
+  public:
+    using FmIndexType = FmIndex<
+        SEQ, INDEX, 2, SORTER, OCC, DnaAlphabet, INDEX_VECTOR>;
+    using CharType    = typename SEQ::value_type;
+
+    /// @brief Occurrence of a pattern: its record, the forward strand
+    ///        offset of its first character, and whether the reverse
+    ///        complement of the pattern occurs there
+    struct Hit
+    {
+        std::size_t record;
+        INDEX       offset;
+        bool        reverse;
+    };
+
+  private:
+    FmIndexType index_;
+
+  public:
+    /// @param records DNA sequences, without $
+    /// @param step Sample rate, valid value are 2^n, n>=0
+    /// @param threads Number of threads, 0 for all hardware threads
+    /// @param kmer_len K of the k-mer interval table, 0 for none
+    /// @param external Scratch space, empty to build in memory
+    explicit StrandFmIndex(
+        const std::vector<SEQ>& records
+      , INDEX step = 1
+      , unsigned threads = 1
+      , unsigned kmer_len = 0
+      , const ExternalMemory& external = ExternalMemory()
+    )
+        : index_(with_reverse_complements(records), CharType('$'), step
+               , threads, kmer_len, external)
+    {}
+
+    /// @brief Number of records, strands counted once
+    std::size_t record_count() const
+    { return index_.record_count() / 2; }
+
+    /// @brief Count the occurrences of pattern on both strands within
+    ///        the records, i.e. the hits of locate(). Matches crossing
+    ///        a record end, or the junction of the forward and reverse
+    ///        complement records, are dropped during the search (see
+    ///        FmIndex::count_records()).
+    template<class PATTERN>
+    INDEX count(const PATTERN& pattern) const
+    { return index_.count_records(pattern); }
+
+    /// @brief Locate all occurrences of pattern on both strands within
+    ///        the records, by one search of the pattern. A pattern
+    ///        equal to its reverse complement has a hit on each strand.
+    /// @return Hits in bwt order
+    template<class PATTERN>
+    std::vector<Hit> locate(const PATTERN& pattern) const
+    {
+        std::vector<Hit> hits;
+        for (const auto& hit : index_.locate_records(pattern))
+            hits.push_back(to_hit(hit.first, hit.second, pattern.size()));
+        return hits;
+    }
+
+    /// @brief Map a location of the underlying index (e.g. of a row of
+    ///        an approximate match) to its hit
+    /// @param location Location in the underlying index's seq
+    /// @param len Length of the match
+    Hit to_hit(INDEX location, INDEX len) const
+    {
+        auto record = index_.to_record(location);
+        return to_hit(record.first, record.second, len);
+    }
+
+    /// @brief Index of the records and their reverse complements, for
+    ///        other searches (search_mismatch() etc.), whose matches
+    ///        cover both strands as well
+    const FmIndexType& index() const
+    { return index_; }
+
+    /// @brief Save index to file, see FmIndex::save()
+    void save(const std::string& path) const
+    { index_.save(path); }
+
+    /// @brief Map an index file written by save(), see FmIndex::load()
+    static StrandFmIndex load(const std::string& path)
+    { return StrandFmIndex(FmIndexType::load(path)); }
+
+  private:
+    explicit StrandFmIndex(FmIndexType index)
+        : index_(std::move(index))
+    {}
+
+    /// @brief Hit of a match at offset of record (of the underlying
+    ///        index), len characters long
+    Hit to_hit(std::size_t record, INDEX offset, INDEX len) const
+    {
+        auto count = record_count();
+        if (record < count)
+            return Hit {record, offset, false};
+
+        // offset in the reverse complement of the record's
+        record -= count;
+        return Hit {record
+                  , INDEX(index_.record_length(record) - offset - len)
+                  , true};
+    }
+
+    /// @brief The records followed by their reverse complements
+    static std::vector<SEQ> with_reverse_complements(
+        const std::vector<SEQ>& records)
+    {
+        static constexpr char complement[] = "TGCA";
+        DnaAlphabet map;
+        std::vector<SEQ> both(records);
+        both.reserve(records.size() * 2);
+        for (const auto& record : records)
+        {
+            SEQ rc;
+            rc.reserve(record.size());
+            for (auto i = record.size(); i > 0; i--)
+                rc.push_back(complement[map(record[i - 1])]);
+            both.push_back(std::move(rc));
+        }
+        return both;
+    }
+};
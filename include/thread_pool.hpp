@@ -0,0 +1,128 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+
+/// @brief Fork-join thread pool. run() executes a task on every
+///        thread (the caller being thread 0) and returns once all of
+///        them finish, so a pool can be reused for many short
+///        parallel steps without spawning threads each time.
+class ThreadPool
+{
+    std::vector<std::thread>       workers_;
+    std::mutex                     mutex_;
+    std::condition_variable        start_cv_;
+    std::condition_variable        done_cv_;
+    std::function<void(unsigned)>  task_;
+    uint64_t                       generation_ = 0;
+    unsigned                       pending_ = 0;
+    bool                           stop_ = false;
+
+  public:
+    /// @param threads Total number of threads including the caller,
+    ///        0 for all hardware threads
+    explicit ThreadPool(unsigned threads)
+    {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned tid = 1; tid < threads; tid++)
+            workers_.emplace_back([this, tid]{ work(tid); });
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        start_cv_.notify_all();
+        for (auto& worker : workers_)
+            worker.join();
+    }
+
+    unsigned size() const
+    { return workers_.size() + 1; }
+
+    /// @brief Call task(tid) for every tid in [0, size()), wait for
+    ///        all of them
+    void run(const std::function<void(unsigned)>& task)
+    {
+        if (workers_.empty())
+            return task(0);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            task_ = task;
+            pending_ = workers_.size();
+            generation_++;
+        }
+        start_cv_.notify_all();
+        task(0);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [this]{ return pending_ == 0; });
+    }
+
+    /// @brief Split [0, n) into size() contiguous chunks and call
+    ///        f(begin, end, tid) for each of them in parallel
+    /// @param align Chunk boundaries are multiples of align
+    template<class F>
+    void parallel_for(std::size_t n, F f, std::size_t align = 1)
+    {
+        auto threads = size();
+        run([n, align, threads, &f](unsigned tid)
+            {
+                auto begin = chunk_begin(n, tid, threads, align);
+                auto end = chunk_begin(n, tid + 1, threads, align);
+                if (begin < end)
+                    f(begin, end, tid);
+            });
+    }
+
+    /// @brief Begin of chunk tid when [0, n) is split into threads
+    ///        chunks (the end of the last chunk is n)
+    static std::size_t chunk_begin(
+        std::size_t n
+      , unsigned tid
+      , unsigned threads
+      , std::size_t align = 1
+    )
+    {
+        if (tid >= threads)
+            return n;
+        auto begin = n / threads * tid + n % threads * tid / threads;
+        return std::min(n, begin / align * align);
+    }
+
+  private:
+    void work(unsigned tid)
+    {
+        uint64_t seen = 0;
+        while (true)
+        {
+            std::function<void(unsigned)> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                start_cv_.wait(lock,
+                    [this, seen]{ return stop_ || generation_ != seen; });
+                if (stop_)
+                    return;
+                seen = generation_;
+                task = task_;
+            }
+            task(tid);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                pending_--;
+            }
+            done_cv_.notify_one();
+        }
+    }
+};
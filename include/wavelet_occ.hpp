@@ -0,0 +1,183 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+#include "mapped_array.hpp"
+#include "packed_vector.hpp"
+#include "rank_bit_vector.hpp"
+#include "thread_pool.hpp"
+
+/// @brief Occ backend storing the bwt as a wavelet matrix: one bit
+///        vector with rank per bit of the characters, most significant
+///        first, each level holding the bits of the characters stably
+///        sorted by their higher bits (zeros first). occ() follows the
+///        character down the levels, one rank per level, so a query
+///        costs BITS ranks whatever the alphabet size, and the space is
+///        about n * BITS * 8 / 7 bits with no per-character counts.
+///        Meant for large alphabets (protein, bytes), for DNA BlockOcc
+///        reads one cache line per occ() instead of two.
+template<typename INDEX, int BITS>
+class WaveletOcc
+{
+    static_assert(BITS <= 8, "characters are sorted as bytes");
+
+  public:
+    /// @brief Tag stored in index files to detect backend mismatch
+    static constexpr uint32_t type_id = 3;
+
+    static constexpr int alph_size = 1 << BITS;
+
+  private:
+    /// @brief Bit BITS - 1 - l of every character at level l
+    std::array<RankBitVector, BITS> levels_;
+
+    /// @brief Number of zeros of each level
+    MappedArray<uint64_t> zeros_;
+
+    /// @brief Position of the first character c below the last level,
+    ///        where occ(i, c) ends up for i = 0
+    MappedArray<uint64_t> starts_;
+
+    INDEX                 size_ = 0;
+
+    /// @brief The index of $(sentinal) in bwt, stored as rank 0
+    INDEX                 primary_index_ = 0;
+
+  public:
+    WaveletOcc() = default;
+
+    /// @param bwt Bwt as alphabet rank, any value at primary_index
+    /// @param primary_index The index of $ in bwt
+    /// @param threads Number of threads setting the bits of a level
+    WaveletOcc(const PackedVector<BITS>& bwt, INDEX primary_index
+             , INDEX = 1, unsigned threads = 1)
+        : size_(bwt.size())
+        , primary_index_(primary_index)
+    {
+        std::size_t n = bwt.size();
+        std::vector<uint8_t> chars(n), sorted(n);
+        ThreadPool pool(threads);
+        pool.parallel_for(n, [this, &bwt, &chars](auto begin, auto end, auto)
+            {
+                for (auto i = begin; i < end; i++)
+                    chars[i] = (i == primary_index_) ? 0 : bwt[i];
+            });
+
+        zeros_.resize(BITS);
+        for (auto l = 0; l < BITS; l++)
+        {
+            auto shift = BITS - 1 - l;
+            RankBitVector bits(n);
+            pool.parallel_for(n, [&bits, &chars, shift](auto begin
+                                                      , auto end, auto)
+                {
+                    for (auto i = begin; i < end; i++)
+                        if ((chars[i] >> shift) & 1)
+                            bits.set(i);
+                }, RankBitVector::block_bits);
+            bits.init_rank();
+            zeros_[l] = n - bits.rank(n);
+            levels_[l] = std::move(bits);
+
+            // stable sort by this bit for the next level
+            std::size_t zero = 0, one = zeros_[l];
+            for (auto c : chars)
+                sorted[((c >> shift) & 1) ? one++ : zero++] = c;
+            chars.swap(sorted);
+        }
+
+        starts_.resize(alph_size);
+        for (auto c = 0; c < alph_size; c++)
+            starts_[c] = descend(0, c);
+    }
+
+    /// @brief Get occurence of character c uptile bwt index i
+    /// @param i Bwt index
+    /// @param c Rank of character
+    /// @return Number of occurence
+    INDEX occ(INDEX i, INDEX c) const
+    {
+        INDEX count = descend(i, c) - starts_[c];
+        if (c == 0 && primary_index_ < i)
+            count--;
+        return count;
+    }
+
+    /// @brief Hint that occ(i, c) or [i] is coming, fetch the block of
+    ///        i in the first level (the others depend on it)
+    void prefetch(INDEX i) const
+    { levels_[0].prefetch(i); }
+
+    /// @brief Rank of the i-th character in bwt, 0 at $
+    INDEX operator[](INDEX i) const
+    {
+        std::size_t pos = i;
+        INDEX c = 0;
+        for (auto l = 0; l < BITS; l++)
+        {
+            auto& bits = levels_[l];
+            auto ones = bits.rank(pos);
+            if (bits[pos])
+            {
+                c |= INDEX(1) << (BITS - 1 - l);
+                pos = zeros_[l] + ones;
+            }
+            else
+                pos -= ones;
+        }
+        return c;
+    }
+
+    std::size_t size() const
+    { return size_; }
+
+    void save(std::ostream& os) const
+    {
+        save_pod(os, uint64_t(size_));
+        save_pod(os, uint64_t(primary_index_));
+        zeros_.save(os);
+        starts_.save(os);
+        for (const auto& bits : levels_)
+            bits.save(os);
+    }
+
+    void map(const char*& ptr, const char* end)
+    {
+        uint64_t size, primary_index;
+        map_pod(ptr, end, size);
+        map_pod(ptr, end, primary_index);
+        size_ = size;
+        primary_index_ = primary_index;
+        zeros_.map(ptr, end);
+        starts_.map(ptr, end);
+        for (auto& bits : levels_)
+        {
+            bits.map(ptr, end);
+            if (bits.size() != size)
+                throw std::runtime_error("corrupted index file");
+        }
+        if (zeros_.size() != BITS || starts_.size() != alph_size)
+            throw std::runtime_error("corrupted index file");
+    }
+
+  private:
+    /// @brief Position below the last level of the i-th position of
+    ///        the first one, following the bits of c
+    std::size_t descend(std::size_t i, INDEX c) const
+    {
+        for (auto l = 0; l < BITS; l++)
+        {
+            auto ones = levels_[l].rank(i);
+            i = ((c >> (BITS - 1 - l)) & 1) ? zeros_[l] + ones : i - ones;
+        }
+        return i;
+    }
+};
+
+template<typename INDEX, int BITS>
+constexpr uint32_t WaveletOcc<INDEX, BITS>::type_id;
+
+template<typename INDEX, int BITS>
+constexpr int WaveletOcc<INDEX, BITS>::alph_size;
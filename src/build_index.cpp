@@ -1,89 +1,84 @@
 #include <iostream>
 #include <fstream>
+#include <cstdlib>
+#include <memory>
 #include <vector>
 #include <chrono>
-#include <random>
-#include "fm_index.hpp"
-#include "saca_k.hpp"
+#include <string>
+#include <limits>
+#include "dna_fm_index.hpp"
+#include "sequence_file.hpp"
+#include "build_stats.hpp"
+
+template<typename INDEX, typename INDEX_VECTOR = std::vector<INDEX>>
+void build(
+    const std::vector<char>& seq
+  , unsigned threads
+  , const ExternalMemory& external
+  , const char* out_path
+)
+{
+    DnaFmIndex<INDEX, INDEX_VECTOR> index(seq, 16, threads, 0, external);
+    if (out_path)
+        index.save(out_path);
+}
 
 int main(int argc, char** argv)
 {
-    if (argc != 2)
+    if (argc < 3 || argc > 6)
     {
-        std::cerr << "usage: " << argv[0] << " FILE\n";
+        std::cerr << "usage: " << argv[0] 
+                  << " FILE OUT [THREADS [SCRATCH_DIR [SA_BUDGET_MB]]]\n"
+                  << "save the index of FILE to OUT (read by fm_search "
+                  << "and fm_server), - to only build it\n"
+                  << "the suffix array spills to SCRATCH_DIR beyond "
+                  << "SA_BUDGET_MB (default 1024), the other "
+                  << "construction arrays stay in memory\n"
+                  << "set FM_INDEX_STATS=PATH to write the time and "
+                  << "memory of each construction phase as JSON\n";
         return 1;
     }
-    std::ifstream ifs(argv[1]);
-
-    // Check file size
-    int file_size;
-    try {
-        ifs.seekg(0, std::ios_base::end);
-        file_size = ifs.tellg();
-        std::cerr << "file size: " << file_size << ", ";
-        ifs.seekg(0); // rewind
-    } catch (const std::ios_base::failure& e)
-    {
-        std::cerr << "Can't seekg: " << e.what() 
-                  << ", error code: " << e.code() << "\n";
-    }
+    std::string out = argv[2];
+    const char* out_path = (out == "-") ? nullptr : out.c_str();
+    unsigned threads = (argc >= 4) ? std::stoul(argv[3]) : 1;
+    ExternalMemory external;
+    if (argc >= 5)
+        external.scratch_dir = argv[4];
+    if (argc >= 6)
+        external.sa_budget = std::stoull(argv[5]) << 20;
 
-    // Read genome
-    std::default_random_engine eng;
-    std::uniform_int_distribution<int> dist(0, 3); 
-    std::vector<char> seq;
-    std::vector<char> char_set {'A', 'C', 'G', 'T'};
-    seq.reserve(file_size);
-    std::string buf;
+    // Read genome, bases other than ACGT are replaced by random ones
     auto start = std::chrono::high_resolution_clock::now();
-    while (std::getline(ifs, buf))
-    {
-        for (auto& chr : buf)
-        {
-            switch (chr)
-            {
-                case 'A': case 'a': seq.push_back('A'); break;
-                case 'C': case 'c': seq.push_back('C'); break;
-                case 'G': case 'g': seq.push_back('G'); break;
-                case 'T': case 't': seq.push_back('T'); break;
-                default: seq.push_back(char_set[dist(eng)]);
-            }
-        }
-    }
-    seq.push_back('A'); // $
-    ifs.close();
+    SequenceFile file(
+        argv[1], make_dna_encoding('A', 'C', 'G', 'T'), threads);
+    auto seq = std::move(file.seq());
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsed = end - start;
-    std::cerr << "seq size: " << seq.size() << ", "
+    std::cerr << "records: " << file.records().size() << ", "
+              << "seq size: " << seq.size() << ", "
               << "file read time: " << elapsed.count() << "s\n";
 
-    // debug
-    for (auto& elem : seq)
-        std::cerr << elem;
-    std::cerr << std::endl;
-
-    // construct fm-index
-    auto map = 
-    [](char base) 
-    {
-        switch (base)
-        {
-            case 'A': return 0;
-            case 'C': return 1;
-            case 'G': return 2;
-            case 'T': return 3;
-            default: 
-                std::cerr << "unknown character, ascii code: " 
-                          << (int)base << std::endl;
-                throw std::runtime_error("unknown character");
-        }
-    };
+    // construct fm-index, 64-bit with 40-bit construction arrays
+    // beyond 4G
+    auto stats_path = std::getenv("FM_INDEX_STATS");
+    BuildStats stats;
+    std::unique_ptr<BuildStats::Scope> scope;
+    if (stats_path)
+        scope = std::make_unique<BuildStats::Scope>(stats);
     start = std::chrono::high_resolution_clock::now();
-    FmIndex<decltype(seq), uint32_t, 2, SACA_K> index(seq, map, 16);
+    if (seq.size() <= std::numeric_limits<uint32_t>::max())
+        build<uint32_t>(seq, threads, external, out_path);
+    else
+        build<uint64_t, Int40Vector>(seq, threads, external, out_path);
     end = std::chrono::high_resolution_clock::now();
     elapsed = end - start;
     std::cerr << "FmIndex construction time: " 
               << elapsed.count() << "s\n";
+    if (stats_path)
+    {
+        std::ofstream ofs(stats_path);
+        stats.write_json(ofs);
+    }
 
     return 0;
 }
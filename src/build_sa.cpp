@@ -1,58 +1,30 @@
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <chrono>
-#include <random>
+#include <string>
 #include "saca_k.hpp"
+#include "sequence_file.hpp"
 
 int main(int argc, char** argv)
 {
-    if (argc != 2)
+    if (argc != 2 && argc != 3)
     {
-        std::cerr << "usage: " << argv[0] << " FILE\n";
+        std::cerr << "usage: " << argv[0] << " FILE [MAX_THREADS]\n"
+                  << "  with MAX_THREADS, also build with 2, 4, ..., "
+                  << "MAX_THREADS threads and report the scaling\n";
         return 1;
     }
-    std::ifstream ifs(argv[1]);
+    unsigned max_threads = (argc == 3) ? std::stoul(argv[2]) : 1;
 
-    // Check file size
-    int file_size;
-    try {
-        ifs.seekg(0, std::ios_base::end);
-        file_size = ifs.tellg();
-        std::cerr << "file size: " << file_size << ", ";
-        ifs.seekg(0); // rewind
-    } catch (const std::ios_base::failure& e)
-    {
-        std::cerr << "Can't seekg: " << e.what() 
-                  << ", error code: " << e.code() << "\n";
-    }
-
-    // Read genome
-    std::default_random_engine eng;
-    std::uniform_int_distribution<int> dist(0, 3); 
-    std::vector<char> seq;
-    seq.reserve(file_size);
-    std::string buf;
+    // Read genome, bases other than ACGT are replaced by random ones
     auto start = std::chrono::high_resolution_clock::now();
-    while (std::getline(ifs, buf))
-    {
-        for (auto& chr : buf)
-        {
-            switch (chr)
-            {
-                case 'A': case 'a': seq.push_back(0); break;
-                case 'C': case 'c': seq.push_back(1); break;
-                case 'G': case 'g': seq.push_back(2); break;
-                case 'T': case 't': seq.push_back(3); break;
-                default: seq.push_back(dist(eng));
-            }
-        }
-    }
-    seq.push_back(0); // $
-    ifs.close();
+    SequenceFile file(
+        argv[1], make_dna_encoding(0, 1, 2, 3), max_threads);
+    auto seq = std::move(file.seq());
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsed = end - start;
-    std::cerr << "seq size: " << seq.size() << ", "
+    std::cerr << "records: " << file.records().size() << ", "
+              << "seq size: " << seq.size() << ", "
               << "file read time: " << elapsed.count() << "s\n";
 
     // Construct suffix array 
@@ -65,5 +37,26 @@ int main(int argc, char** argv)
     std::cerr << "Suffix array construction time: " 
               << elapsed.count() << "s\n";
 
+    // Scaling benchmark, results must match the sequential sa
+    auto sequential_time = elapsed.count();
+    for (unsigned threads = 2; threads <= max_threads; 
+         threads = (threads * 2 > max_threads && threads != max_threads)
+                 ? max_threads : threads * 2)
+    {
+        std::vector<uint32_t> parallel_sa(seq.size());
+        SACA_K<decltype(seq), decltype(parallel_sa)> 
+            parallel_builder(threads);
+        start = std::chrono::high_resolution_clock::now();
+        parallel_builder.build(seq, parallel_sa, 4);
+        end = std::chrono::high_resolution_clock::now();
+        elapsed = end - start;
+        std::cerr << "threads: " << threads
+                  << ", construction time: " << elapsed.count() << "s"
+                  << ", speedup: " << sequential_time / elapsed.count()
+                  << (parallel_sa == sa ? "" : ", MISMATCH") << "\n";
+        if (parallel_sa != sa)
+            return 1;
+    }
+
     return 0;
 }
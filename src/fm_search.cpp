@@ -0,0 +1,120 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "dna_fm_index.hpp"
+#include "sequence_file.hpp"
+#include "batch_pipeline.hpp"
+
+struct Query
+{
+    std::string name;
+    std::string seq;
+};
+
+/// @brief Queries searched as one task
+constexpr std::size_t batch_size = 4096;
+
+/// @brief Search every query of input, write a line per query in input
+///        order: name, count and, if at most max_hits, the sorted
+///        locations (comma separated)
+template<class FM_INDEX>
+void search(const FM_INDEX& index, std::istream& input
+          , unsigned threads, std::size_t max_hits)
+{
+    SequenceReader reader(input);
+    BatchPipeline<std::vector<Query>, std::string> pipeline(threads);
+    std::size_t queries = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    pipeline.run(
+        [&reader, &queries](std::vector<Query>& batch)
+        {
+            Query query;
+            while (batch.size() < batch_size
+                && reader.next(query.name, query.seq))
+                batch.push_back(std::move(query));
+            queries += batch.size();
+            return !batch.empty();
+        },
+        [&index, max_hits](std::vector<Query>& batch, std::string& out
+                         , unsigned)
+        {
+            for (const auto& query : batch)
+            {
+                auto range = index.get_range(query.seq);
+                auto count = range.second - range.first;
+                out += query.name;
+                out += '\t';
+                out += std::to_string(count);
+                out += '\t';
+                if (count != 0 && count <= max_hits)
+                {
+                    auto locations = index.locate_range(range);
+                    std::sort(locations.begin(), locations.end());
+                    for (std::size_t i = 0; i < locations.size(); i++)
+                    {
+                        if (i)
+                            out += ',';
+                        out += std::to_string(locations[i]);
+                    }
+                }
+                out += '\n';
+            }
+        },
+        [](std::string& out)
+        {
+            std::cout.write(out.data(), out.size());
+        });
+    std::cout.flush();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+    std::cerr << "queries: " << queries << ", threads: "
+              << pipeline.threads() << ", search time: "
+              << elapsed.count() << "s\n";
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argc > 5)
+    {
+        std::cerr << "usage: " << argv[0]
+                  << " INDEX [QUERIES [THREADS [MAX_HITS]]]\n"
+                  << "  search FASTA/FASTQ queries (stdin if QUERIES is "
+                  << "- or missing) in the DNA index saved by "
+                  << "build_index, one line per query:\n"
+                  << "  name, count, locations if at most MAX_HITS "
+                  << "(default 100)\n";
+        return 1;
+    }
+    std::string queries_path = (argc >= 3) ? argv[2] : "-";
+    unsigned threads = (argc >= 4) ? std::stoul(argv[3]) : 0;
+    std::size_t max_hits = (argc >= 5) ? std::stoull(argv[4]) : 100;
+
+    std::ios::sync_with_stdio(false);
+    std::ifstream file;
+    if (queries_path != "-")
+    {
+        file.open(queries_path);
+        if (!file)
+        {
+            std::cerr << "can not open " << queries_path << "\n";
+            return 1;
+        }
+    }
+    std::istream& input = file.is_open() ? file : std::cin;
+
+    try
+    {
+        with_dna_fm_index(argv[1], [&](const auto& index)
+            { search(index, input, threads, max_hits); });
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include <iostream>
+#include <csignal>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+#include "dna_fm_index.hpp"
+#include "query_server.hpp"
+
+/// @brief Serve the index until SIGINT or SIGTERM, which the caller
+///        blocked in every thread
+template<class FM_INDEX>
+void serve(const FM_INDEX& index, const std::string& index_path
+         , const std::string& socket_path, unsigned threads
+         , sigset_t signals)
+{
+    QueryServer<FM_INDEX> server(index, socket_path, threads);
+    std::thread waiter([&server, signals]
+        {
+            int signal;
+            sigwait(&signals, &signal);
+            server.stop();
+        });
+    std::cerr << "serving " << index_path << " (" << index.size()
+              << " characters) on " << socket_path << "\n";
+    server.run();
+
+    // wake the waiter if run() returned on an error
+    kill(getpid(), SIGTERM);
+    waiter.join();
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 3 && argc != 4)
+    {
+        std::cerr << "usage: " << argv[0] << " INDEX SOCKET [THREADS]\n"
+                  << "  serve count/locate requests for the DNA index "
+                  << "saved by build_index on a Unix domain socket, "
+                  << "see query_server.hpp\n";
+        return 1;
+    }
+    unsigned threads = (argc == 4) ? std::stoul(argv[3]) : 0;
+
+    // signals are taken by the waiter thread of serve()
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    try
+    {
+        with_dna_fm_index(argv[1], [&](const auto& index)
+            { serve(index, argv[1], argv[2], threads, signals); });
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "batch_pipeline.hpp"
+#include "sequence_file.hpp"
+
+TEST(BatchPipeline, InputOrder)
+{
+    for (auto threads : {1, 3, 8})
+    {
+        BatchPipeline<std::vector<int>, std::vector<int>> pipeline(
+            threads, 5);
+        int next = 0;
+        std::atomic<int> pending(0), max_pending(0);
+        std::vector<int> written;
+        pipeline.run(
+            [&next, &pending, &max_pending](std::vector<int>& batch)
+            {
+                if (next == 300)
+                    return false;
+                for (auto i = 0; i < 7; i++)
+                    batch.push_back(next * 7 + i);
+                next++;
+                auto now = ++pending;
+                if (now > max_pending)
+                    max_pending = now;
+                return true;
+            },
+            [](std::vector<int>& batch, std::vector<int>& out, unsigned)
+            {
+                // uneven batch times, workers steal from slow ones
+                std::this_thread::sleep_for(
+                    std::chrono::microseconds(batch[0] * 37 % 500));
+                for (auto i : batch)
+                    out.push_back(i * 2);
+            },
+            [&written, &pending](std::vector<int>& out)
+            {
+                written.insert(written.end(), out.begin(), out.end());
+                pending--;
+            });
+
+        ASSERT_EQ(written.size(), 300 * 7);
+        for (std::size_t i = 0; i < written.size(); i++)
+            ASSERT_EQ(written[i], i * 2) << "threads: " << threads;
+        EXPECT_LE(max_pending, 6);
+    }
+}
+
+TEST(BatchPipeline, Empty)
+{
+    BatchPipeline<int, int> pipeline(4);
+    int written = 0;
+    pipeline.run([](int&){ return false; }
+               , [](int&, int&, unsigned){}
+               , [&written](int&){ written++; });
+    EXPECT_EQ(written, 0);
+}
+
+TEST(BatchPipeline, Exceptions)
+{
+    // each stage in turn throws at its 20th batch, run() rethrows once
+    // every thread is joined, whatever the number of workers
+    for (auto stage = 0; stage < 3; stage++)
+        for (auto threads : {1, 4})
+        {
+            BatchPipeline<int, int> pipeline(threads, 3);
+            int next = 0;
+            auto fail = [stage](int i, int at)
+                {
+                    if (stage == at && i == 20)
+                        throw std::runtime_error("stage");
+                };
+            EXPECT_THROW(pipeline.run(
+                    [&next, &fail](int& batch)
+                    {
+                        fail(next, 0);
+                        batch = next++;
+                        return next <= 100;
+                    },
+                    [&fail](int& batch, int& out, unsigned)
+                    {
+                        fail(batch, 1);
+                        out = batch;
+                    },
+                    [&fail](int& out){ fail(out, 2); })
+              , std::runtime_error) << "stage: " << stage;
+
+            // and can run again
+            int written = 0;
+            next = 0;
+            pipeline.run([&next](int& batch)
+                             { batch = next++; return next <= 10; }
+                       , [](int& batch, int& out, unsigned){ out = batch; }
+                       , [&written](int& out){ EXPECT_EQ(out, written++); });
+            EXPECT_EQ(written, 10);
+        }
+}
+
+TEST(BatchPipeline, MalformedInput)
+{
+    // as fm_search reads queries: the reader error reaches the caller
+    std::string fastq;
+    for (auto i = 0; i < 50; i++)
+        fastq += "@r" + std::to_string(i) + "\nACGT\n+\nIIII\n";
+    fastq += "@broken\nACGT\nIIII\n";
+    std::istringstream is(fastq);
+    SequenceReader reader(is);
+
+    BatchPipeline<std::vector<std::string>, std::size_t> pipeline(2, 2);
+    std::size_t reads = 0;
+    EXPECT_THROW(pipeline.run(
+            [&reader](std::vector<std::string>& batch)
+            {
+                std::string name, seq;
+                while (batch.size() < 8 && reader.next(name, seq))
+                    batch.push_back(seq);
+                return !batch.empty();
+            },
+            [](std::vector<std::string>& batch, std::size_t& out, unsigned)
+            { out = batch.size(); },
+            [&reads](std::size_t& out){ reads += out; })
+      , std::runtime_error);
+    EXPECT_LE(reads, 50u);
+}
@@ -0,0 +1,243 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include "bidirectional_fm_index.hpp"
+#include "saca_k.hpp"
+#include "test_util.hpp"
+
+using SeqType = std::string;
+using BiFmIndexType = BidirectionalFmIndex<
+    SeqType, uint32_t, 2, SACA_K, BlockOcc, DnaAlphabet>;
+
+/// @brief Check both sides of interval against plain searches
+template<class BI_FM_INDEX>
+void check_interval(const BI_FM_INDEX& index, const SeqType& pattern
+                  , const typename BI_FM_INDEX::Interval& interval)
+{
+    SeqType reversed(pattern.rbegin(), pattern.rend());
+    auto fwd = index.forward().get_range(pattern);
+    auto rev = index.reverse().get_range(reversed);
+    ASSERT_EQ(interval.size, fwd.second - fwd.first) << pattern;
+    ASSERT_EQ(interval.size, rev.second - rev.first) << pattern;
+    if (interval.size != 0)
+    {
+        EXPECT_EQ(interval.fwd, fwd.first) << pattern;
+        EXPECT_EQ(interval.rev, rev.first) << pattern;
+    }
+}
+
+TEST(BidirectionalFmIndex, Extend)
+{
+    std::default_random_engine eng;
+    for (auto max_rank : {1, 3})
+    {
+        // fewer distinct characters, longer repeats
+        std::uniform_int_distribution<int> dist(0, max_rank);
+        SeqType seq(3000, 'A');
+        std::generate(seq.begin(), seq.end()-1,
+            [&eng, &dist](){ return "ACGT"[dist(eng)]; });
+        BiFmIndexType index(seq, 4);
+
+        // grow substrings of seq (and beyond them) from a middle
+        // character, to the left or to the right at random
+        std::uniform_int_distribution<std::size_t> pos(0, seq.size() - 2);
+        std::bernoulli_distribution left(0.5);
+        for (auto i = 0; i < 200; i++)
+        {
+            auto begin = pos(eng), end = begin;
+            SeqType pattern;
+            auto interval = index.whole();
+            for (auto step = 0; step < 30; step++)
+            {
+                if ((left(eng) && begin > 0) || end == seq.size() - 1)
+                {
+                    auto c = (step % 7 == 6) ? 'T' : seq[--begin];
+                    pattern.insert(pattern.begin(), c);
+                    interval = index.extend_left(interval, c);
+                }
+                else
+                {
+                    auto c = (step % 7 == 6) ? 'T' : seq[end++];
+                    pattern.push_back(c);
+                    interval = index.extend_right(interval, c);
+                }
+                check_interval(index, pattern, interval);
+                if (interval.size == 0)
+                    break;
+            }
+        }
+    }
+}
+
+TEST(BidirectionalFmIndex, SampledOcc)
+{
+    // the reverse index samples one location, its occ samples every
+    // step characters like the forward one
+    using SampledBiFmIndexType = BidirectionalFmIndex<
+        SeqType, uint32_t, 2, SACA_K, SampledOcc, DnaAlphabet>;
+    auto seq = random_dna(3000, 5);
+    SampledBiFmIndexType index(seq, 16);
+    EXPECT_EQ(index.forward().locate(SeqType("ACGTA"))
+            , BiFmIndexType(seq, 16).forward().locate(SeqType("ACGTA")));
+
+    // grow substrings of seq to the right, then to the left
+    std::default_random_engine eng;
+    std::uniform_int_distribution<std::size_t> pos(10, seq.size() - 20);
+    for (auto i = 0; i < 100; i++)
+    {
+        auto begin = pos(eng), end = begin;
+        SeqType pattern;
+        auto interval = index.whole();
+        while (end < begin + 10)
+        {
+            pattern.push_back(seq[end]);
+            interval = index.extend_right(interval, seq[end++]);
+            check_interval(index, pattern, interval);
+        }
+        while (end - begin < 20)
+        {
+            pattern.insert(pattern.begin(), seq[--begin]);
+            interval = index.extend_left(interval, seq[begin]);
+            check_interval(index, pattern, interval);
+        }
+    }
+}
+
+TEST(BidirectionalFmIndex, LocateAndLoad)
+{
+    SeqType seq("ACGTTGCAACGTACGA");
+    BiFmIndexType index(seq, 2);
+    auto interval = index.extend_right(
+        index.get_interval(SeqType("AC")), 'G');
+    auto locations = index.locate(interval);
+    std::sort(locations.begin(), locations.end());
+    EXPECT_EQ(locations, std::vector<uint32_t>({0, 8, 12}));
+
+    TempDir dir;
+    auto path = dir.file("bidirectional_test.bin");
+    index.save(path);
+    auto loaded = BiFmIndexType::load(path);
+    auto loaded_interval = loaded.extend_left(
+        loaded.get_interval(SeqType("CG")), 'A');
+    EXPECT_EQ(loaded_interval.fwd, interval.fwd);
+    EXPECT_EQ(loaded_interval.rev, interval.rev);
+    EXPECT_EQ(loaded_interval.size, 3);
+}
+
+TEST(BidirectionalFmIndex, SearchScheme)
+{
+    auto seq = random_dna(5000, 7);
+    std::default_random_engine eng;
+    std::uniform_int_distribution<int> dist(0, 3);
+    // repeats with a few differences, so hits fall in every part
+    for (auto i = 0; i < 40; i++)
+    {
+        auto from = 100 * i, to = 2500 + 60 * i;
+        for (auto j = 0; j < 30; j++)
+            seq[to + j] = (j % 11 == i % 11) ? 'A' : seq[from + j];
+    }
+    BiFmIndexType index(seq, 4);
+
+    auto compare = [](const auto& a, const auto& b)
+    {
+        ASSERT_EQ(a.size(), b.size());
+        for (std::size_t i = 0; i < a.size(); i++)
+        {
+            EXPECT_EQ(a[i].begin, b[i].begin);
+            EXPECT_EQ(a[i].end, b[i].end);
+            EXPECT_EQ(a[i].errors, b[i].errors);
+        }
+    };
+    std::uniform_int_distribution<std::size_t> pos(0, seq.size() - 40);
+    for (auto i = 0; i < 60; i++)
+    {
+        auto len = (i % 4 == 0) ? 2 + i % 3 : 30;
+        auto pattern = seq.substr(pos(eng), len);
+        for (auto e = 0; e < i % 3; e++)
+            pattern[dist(eng) % len] = "ACGT"[dist(eng)];
+        for (unsigned k = 0; k <= 3; k++)
+            compare(index.search_mismatch(pattern, k)
+                  , index.forward().search_mismatch(pattern, k));
+    }
+}
+
+/// @brief Matches of pattern occurring at least min_occ times which
+///        can not be extended and are not contained in another, by
+///        counting every substring
+std::vector<std::pair<std::size_t, std::size_t>> naive_smems(
+    const BiFmIndexType& index, const SeqType& pattern, uint32_t min_occ)
+{
+    auto m = pattern.size();
+    auto occurs = [&](std::size_t b, std::size_t e)
+    {
+        return index.forward().count(pattern.substr(b, e - b)) >= min_occ;
+    };
+    std::vector<std::pair<std::size_t, std::size_t>> mems, smems;
+    for (std::size_t b = 0; b < m; b++)
+        for (auto e = b + 1; e <= m; e++)
+            if (occurs(b, e) && (b == 0 || !occurs(b - 1, e))
+                             && (e == m || !occurs(b, e + 1)))
+                mems.emplace_back(b, e);
+    for (const auto& mem : mems)
+        if (std::none_of(mems.begin(), mems.end(), [&mem](const auto& other)
+            {
+                return other != mem && other.first <= mem.first
+                    && mem.second <= other.second;
+            }))
+            smems.push_back(mem);
+    return smems;
+}
+
+TEST(BidirectionalFmIndex, Smems)
+{
+    auto seq = random_dna(3000, 8);
+    std::default_random_engine eng;
+    std::uniform_int_distribution<int> dist(0, 3);
+    // a repeated region to get matches of several occurrences
+    for (auto j = 0; j < 200; j++)
+        seq[2000 + j] = seq[1000 + j] = seq[j];
+    BiFmIndexType index(seq, 4);
+
+    std::uniform_int_distribution<std::size_t> pos(0, seq.size() - 60);
+    for (auto i = 0; i < 60; i++)
+    {
+        // a read with errors, or spliced from two places
+        auto pattern = seq.substr(pos(eng), 40);
+        if (i % 2)
+            pattern = pattern.substr(0, 20) + seq.substr(pos(eng), 20);
+        for (auto e = 0; e < i % 4; e++)
+            pattern[dist(eng) * 13 % 40] = "ACGT"[dist(eng)];
+
+        for (uint32_t min_occ : {1, 2, 3})
+        {
+            auto ans = naive_smems(index, pattern, min_occ);
+            auto smems = index.smems(pattern, 1, 0, min_occ);
+            ASSERT_EQ(smems.size(), ans.size())
+                << pattern << ", min_occ: " << min_occ;
+            for (std::size_t j = 0; j < ans.size(); j++)
+            {
+                EXPECT_EQ(smems[j].begin, ans[j].first);
+                EXPECT_EQ(smems[j].end, ans[j].second);
+                auto range = index.forward().get_range(
+                    pattern.substr(ans[j].first
+                                 , ans[j].second - ans[j].first));
+                EXPECT_EQ(smems[j].interval.fwd, range.first);
+                EXPECT_EQ(smems[j].interval.size
+                        , range.second - range.first);
+            }
+
+            // length and occurrence filters
+            for (const auto& smem : index.smems(pattern, 15, 2, min_occ))
+            {
+                EXPECT_GE(smem.end - smem.begin, 15);
+                EXPECT_LE(smem.interval.size, 2);
+            }
+        }
+    }
+
+    // every match occurs, min_occ 0 would extend past the pattern
+    EXPECT_THROW(index.smems(seq.substr(0, 40), 1, 0, 0)
+               , std::runtime_error);
+    EXPECT_EQ(index.smems(SeqType(), 1, 0, 1).size(), 0);
+}
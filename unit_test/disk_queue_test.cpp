@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+#include "disk_queue.hpp"
+
+TEST(DiskQueue, PopWhilePushing)
+{
+    std::default_random_engine eng;
+    std::uniform_int_distribution<int> dist(0, 2);
+    // buffers smaller than, equal to and larger than the queue
+    for (std::size_t buffer_size : {1, 3, 64, 1000})
+    {
+        DiskQueue<uint32_t> queue("/tmp", buffer_size);
+        std::vector<uint32_t> ans;
+        std::size_t popped = 0;
+        for (uint32_t i = 0; i < 500; i++)
+        {
+            queue.push(i);
+            ans.push_back(i);
+            // pop 0-2 elements after each push
+            for (auto k = dist(eng); k > 0; k--)
+            {
+                uint32_t value;
+                if (!queue.pop(value))
+                {
+                    EXPECT_EQ(popped, ans.size());
+                    break;
+                }
+                ASSERT_EQ(value, ans[popped++]);
+            }
+        }
+        for (uint32_t value; queue.pop(value); )
+            ASSERT_EQ(value, ans[popped++]);
+        EXPECT_EQ(popped, ans.size());
+        EXPECT_EQ(queue.size(), ans.size());
+
+        std::size_t i = ans.size();
+        queue.for_each_reverse([&ans, &i](auto value)
+            { ASSERT_EQ(value, ans[--i]); });
+        EXPECT_EQ(i, 0);
+
+        queue.rewind();
+        for (uint32_t value; queue.pop(value); )
+            ASSERT_EQ(value, ans[i++]);
+        EXPECT_EQ(i, ans.size());
+    }
+}
+
+TEST(DiskQueue, BadDirectory)
+{
+    EXPECT_THROW(DiskQueue<int>("/nonexistent/dir", 16)
+               , std::runtime_error);
+}
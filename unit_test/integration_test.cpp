@@ -1,6 +1,13 @@
 #include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <tuple>
+#include <sstream>
+#include <random>
 #include "fm_index.hpp"
 #include "saca_k.hpp"
+#include "test_util.hpp"
 
 using ::testing::TestWithParam;
 using ::testing::Values;
@@ -113,6 +120,29 @@ class IntegrationTest : public TestWithParam<int>
       , {24, 39, 55, 73}
     }; // lf_mapping(index, char)
     int sample_step; 
+
+    // Brute force count (overlapping), $ excluded from text
+    int count_naive(const std::string& pattern) const
+    {
+        auto text = seq.substr(0, seq.size()-1);
+        int cnt = 0;
+        for (auto pos = text.find(pattern); pos != std::string::npos;
+             pos = text.find(pattern, pos+1))
+            cnt++;
+        return cnt;
+    }
+
+    // Patterns of different length cut from seq, plus some that
+    // do not occur
+    std::vector<std::string> patterns() const
+    {
+        std::vector<std::string> result {
+            "CCCCCCC", "TTTTTT", "GGGGGGGGG", "ACGT", "TATA"};
+        for (auto len = 1; len <= 8; len++)
+            for (std::size_t i = 0; i + len < seq.size(); i += 5)
+                result.push_back(seq.substr(i, len));
+        return result;
+    }
 };
 
 TEST_P(IntegrationTest, Constructor)
@@ -146,6 +176,701 @@ TEST_P(IntegrationTest, Constructor)
     }
 }
 
+// Rank of a DNA base, the mapper of the tests below
+int map(char base)
+{
+    switch (base)
+    {
+        case 'A': return 0;
+        case 'C': return 1;
+        case 'G': return 2;
+        case 'T': return 3;
+        default:
+            throw std::runtime_error("unknown character");
+    }
+}
+
+TEST_P(IntegrationTest, DnaAlphabet)
+{
+    using FmIndexType = 
+        FmIndex<SeqType, IndexType, 2, SACA_K, BlockOcc, DnaAlphabet>;
+    FmIndexType fm_index(seq, sample_step);
+
+    for (std::size_t i = 0; i < seq.size(); i++)
+    {
+        EXPECT_EQ(fm_index.get_location(i), sa[i]);
+        EXPECT_EQ(fm_index.lf_mapping(i, 'A'), lf_map[i][0]);
+        EXPECT_EQ(fm_index.lf_mapping(i, 'c'), lf_map[i][1]);
+        EXPECT_EQ(fm_index.lf_mapping(i, 'G'), lf_map[i][2]);
+        EXPECT_EQ(fm_index.lf_mapping(i, 't'), lf_map[i][3]);
+    }
+    for (const auto& pattern : patterns())
+        EXPECT_EQ(fm_index.count(pattern), count_naive(pattern));
+
+    // stateless alphabet needs no mapper to load
+    TempDir dir;
+    auto path = dir.file("fm_index_dna.bin");
+    fm_index.save(path);
+    auto loaded = FmIndexType::load(path);
+    for (const auto& pattern : patterns())
+        EXPECT_EQ(loaded.locate(pattern), fm_index.locate(pattern));
+}
+
+TEST_P(IntegrationTest, SampledOccBackend)
+{
+    FmIndex<SeqType, IndexType, 2, SACA_K, SampledOcc> fm_index(
+        seq, map, sample_step);
+
+    for (std::size_t i = 0; i < seq.size(); i++)
+    {
+        EXPECT_EQ(fm_index.get_location(i), sa[i]);
+        EXPECT_EQ(fm_index.lf_mapping(i, 'A'), lf_map[i][0]);
+        EXPECT_EQ(fm_index.lf_mapping(i, 'C'), lf_map[i][1]);
+        EXPECT_EQ(fm_index.lf_mapping(i, 'G'), lf_map[i][2]);
+        EXPECT_EQ(fm_index.lf_mapping(i, 'T'), lf_map[i][3]);
+    }
+    for (const auto& pattern : patterns())
+        EXPECT_EQ(fm_index.count(pattern), count_naive(pattern));
+}
+
+TEST_P(IntegrationTest, WaveletOccBackend)
+{
+    FmIndex<SeqType, IndexType, 2, SACA_K, WaveletOcc> fm_index(
+        seq, map, sample_step);
+
+    for (std::size_t i = 0; i < seq.size(); i++)
+    {
+        EXPECT_EQ(fm_index.get_location(i), sa[i]);
+        EXPECT_EQ(fm_index.lf_mapping(i, 'A'), lf_map[i][0]);
+        EXPECT_EQ(fm_index.lf_mapping(i, 'C'), lf_map[i][1]);
+        EXPECT_EQ(fm_index.lf_mapping(i, 'G'), lf_map[i][2]);
+        EXPECT_EQ(fm_index.lf_mapping(i, 'T'), lf_map[i][3]);
+    }
+    for (const auto& pattern : patterns())
+        EXPECT_EQ(fm_index.count(pattern), count_naive(pattern));
+}
+
+TEST_P(IntegrationTest, Count)
+{
+    FmIndex<SeqType, IndexType, 2, SACA_K> fm_index(
+        seq, map, sample_step);
+
+    EXPECT_EQ(fm_index.count(std::string()), seq.size());
+    for (const auto& pattern : patterns())
+        EXPECT_EQ(fm_index.count(pattern), count_naive(pattern))
+            << "pattern: " << pattern;
+}
+
+TEST_P(IntegrationTest, CountBatch)
+{
+    FmIndex<SeqType, IndexType, 2, SACA_K> fm_index(
+        seq, map, sample_step);
+
+    auto queries = patterns();
+    queries.push_back(std::string());
+    auto counts = fm_index.count_batch(queries);
+    ASSERT_EQ(counts.size(), queries.size());
+    for (std::size_t i = 0; i < queries.size(); i++)
+        EXPECT_EQ(counts[i], fm_index.count(queries[i]))
+            << "pattern: " << queries[i];
+}
+
+TEST_P(IntegrationTest, RangeBatch)
+{
+    FmIndex<SeqType, IndexType, 2, SACA_K> fm_index(
+        seq, map, sample_step);
+    FmIndex<SeqType, IndexType, 2, SACA_K> kmer_index(
+        seq, map, sample_step, 1, 3);
+
+    auto queries = patterns();
+    // a window of 0 searches one pattern at a time
+    for (auto window : {0, 1, 3, 32, 1000})
+        for (const auto& index : {&fm_index, &kmer_index})
+        {
+            auto ranges = index->get_range_batch(queries, window);
+            auto counts = index->count_batch(queries, window);
+            ASSERT_EQ(ranges.size(), queries.size());
+            for (std::size_t i = 0; i < queries.size(); i++)
+            {
+                EXPECT_EQ(counts[i], count_naive(queries[i]));
+                if (counts[i] != 0)
+                {
+                    EXPECT_EQ(ranges[i], fm_index.get_range(queries[i]))
+                        << "window: " << window 
+                        << ", pattern: " << queries[i];
+                }
+            }
+        }
+}
+
+TEST_P(IntegrationTest, Locate)
+{
+    FmIndex<SeqType, IndexType, 2, SACA_K> fm_index(
+        seq, map, sample_step);
+
+    for (const auto& pattern : patterns())
+    {
+        auto locations = fm_index.locate(pattern);
+        ASSERT_EQ(locations.size(), count_naive(pattern))
+            << "pattern: " << pattern;
+
+        // in bwt order, same as get_location over the range
+        auto range = fm_index.get_range(pattern);
+        for (auto i = range.first; i < range.second; i++)
+            EXPECT_EQ(locations[i - range.first], sa[i]);
+
+        std::sort(locations.begin(), locations.end());
+        for (const auto& loc : locations)
+            EXPECT_EQ(seq.compare(loc, pattern.size(), pattern), 0);
+    }
+}
+
+TEST_P(IntegrationTest, SaveLoad)
+{
+    using FmIndexType = FmIndex<SeqType, IndexType, 2, SACA_K>;
+    FmIndexType fm_index(seq, map, sample_step);
+
+    TempDir dir;
+    auto path = dir.file("fm_index.bin");
+    fm_index.save(path);
+    {
+        auto loaded = FmIndexType::load(path, map);
+        for (std::size_t i = 0; i < seq.size(); i++)
+        {
+            EXPECT_EQ(loaded.get_location(i), sa[i]);
+            EXPECT_EQ(loaded.lf_mapping(i, 'A'), lf_map[i][0]);
+            EXPECT_EQ(loaded.lf_mapping(i, 'C'), lf_map[i][1]);
+            EXPECT_EQ(loaded.lf_mapping(i, 'G'), lf_map[i][2]);
+            EXPECT_EQ(loaded.lf_mapping(i, 'T'), lf_map[i][3]);
+        }
+        for (const auto& pattern : patterns())
+        {
+            EXPECT_EQ(loaded.count(pattern), fm_index.count(pattern));
+            EXPECT_EQ(loaded.locate(pattern), fm_index.locate(pattern));
+        }
+
+        // copy shares the mapping
+        auto copied = loaded;
+        EXPECT_EQ(copied.get_location(seq.size() - 1)
+                , sa[seq.size() - 1]);
+    }
+
+    // backend mismatch
+    using SampledOccIndexType = 
+        FmIndex<SeqType, IndexType, 2, SACA_K, SampledOcc>;
+    EXPECT_THROW(SampledOccIndexType::load(path, map)
+               , std::runtime_error);
+
+    // truncated file
+    {
+        std::ifstream ifs(path, std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(ifs))
+                          , std::istreambuf_iterator<char>());
+        std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+        ofs.write(content.data(), content.size() / 2);
+    }
+    EXPECT_THROW(FmIndexType::load(path, map), std::runtime_error);
+    std::remove(path.c_str());
+    EXPECT_THROW(FmIndexType::load(path, map), std::runtime_error);
+}
+
+TEST_P(IntegrationTest, KmerTable)
+{
+    using FmIndexType = FmIndex<SeqType, IndexType, 2, SACA_K>;
+    FmIndexType plain(seq, map, sample_step);
+    TempDir dir;
+    auto path = dir.file("kmer_table.fmi");
+
+    for (auto k : {1, 3, 5, 8})
+    {
+        FmIndexType fm_index(seq, map, sample_step, 1, k);
+        fm_index.save(path);
+        auto loaded = FmIndexType::load(path, map);
+        for (const auto& index : {&fm_index, &loaded})
+        {
+            for (const auto& pattern : patterns())
+            {
+                ASSERT_EQ(index->count(pattern), count_naive(pattern))
+                    << "k: " << k << ", pattern: " << pattern;
+                if (plain.count(pattern) != 0)
+                {
+                    EXPECT_EQ(index->get_range(pattern)
+                            , plain.get_range(pattern));
+                }
+                EXPECT_EQ(index->locate(pattern), plain.locate(pattern));
+            }
+            EXPECT_EQ(index->count_batch(patterns())
+                    , plain.count_batch(patterns()));
+        }
+    }
+}
+
 // Parameterized test: pass in sample_step
 INSTANTIATE_TEST_CASE_P(DifferentSampleRate, IntegrationTest
     , Values(1, 2, 4, 8, 16, 32));
+
+/// @brief Suffix array by sorting suffixes directly, the last
+///        character of seq is taken as $
+template<class MAPPER>
+std::vector<uint32_t> naive_sa(const std::string& seq, MAPPER map)
+{
+    std::vector<int> rank(seq.size(), -1);
+    std::transform(seq.begin(), seq.end()-1, rank.begin(), map);
+    std::vector<uint32_t> sa(seq.size());
+    std::iota(sa.begin(), sa.end(), 0);
+    std::sort(sa.begin(), sa.end(), [&rank](auto a, auto b)
+        {
+            return std::lexicographical_compare(
+                rank.begin() + a, rank.end()
+              , rank.begin() + b, rank.end());
+        });
+    return sa;
+}
+
+template<class FM_INDEX>
+void check_locations(
+    const FM_INDEX& fm_index
+  , const std::vector<uint32_t>& sa
+)
+{
+    for (std::size_t i = 0; i < sa.size(); i++)
+        ASSERT_EQ(fm_index.get_location(i), sa[i]) << "row " << i;
+}
+
+TEST(Construction, RepeatedCharacter)
+{
+    using FmIndexType = FmIndex<
+        SeqType, uint32_t, 2, SACA_K, BlockOcc, DnaAlphabet>;
+
+    for (auto len : {2, 3, 10, 17})
+    {
+        SeqType seq(len, 'A');
+        for (auto step : {1, 2, 4})
+            check_locations(FmIndexType(seq, step)
+                          , naive_sa(seq, DnaAlphabet()));
+    }
+}
+
+TEST(Construction, RandomDna)
+{
+    using FmIndexType = FmIndex<
+        SeqType, uint32_t, 2, SACA_K, BlockOcc, DnaAlphabet>;
+
+    std::default_random_engine eng;
+    for (auto len : {3, 10, 50, 300, 5000})
+        for (auto max_rank = 1; max_rank < 4; max_rank++)
+        {
+            // fewer distinct characters, more repeated LMS
+            std::uniform_int_distribution<int> dist(0, max_rank);
+            SeqType seq(len, 'A');
+            std::generate(seq.begin(), seq.end()-1,
+                [&eng, &dist](){ return "ACGT"[dist(eng)]; });
+            for (auto step : {1, 4})
+                check_locations(FmIndexType(seq, step)
+                              , naive_sa(seq, DnaAlphabet()));
+        }
+}
+
+TEST(Construction, Threads)
+{
+    using FmIndexType = FmIndex<
+        SeqType, uint32_t, 2, SACA_K, BlockOcc, DnaAlphabet>;
+    using SampledFmIndexType = FmIndex<
+        SeqType, uint32_t, 2, SACA_K, SampledOcc, DnaAlphabet>;
+
+    auto seq = random_dna(20000, 1);
+    auto sa = naive_sa(seq, DnaAlphabet());
+
+    for (auto threads : {2, 5})
+    {
+        check_locations(FmIndexType(seq, 4, threads), sa);
+        check_locations(SampledFmIndexType(seq, 8, threads), sa);
+    }
+}
+
+TEST(Construction, KmerTable)
+{
+    using FmIndexType = FmIndex<
+        SeqType, uint32_t, 2, SACA_K, BlockOcc, DnaAlphabet>;
+
+    // every k-mer, including those overlapping the last k-1
+    // suffixes (shorter than k) and those longer than the seq
+    std::default_random_engine eng;
+    std::uniform_int_distribution<int> dist(0, 1);
+    SeqType random(300, 'A');
+    std::generate(random.begin(), random.end()-1,
+        [&eng, &dist](){ return "AC"[dist(eng)]; });
+    for (const auto& seq : {random, SeqType("CAAAA"), SeqType("GA")})
+    {
+        FmIndexType plain(seq);
+        for (auto k = 1; k <= 6; k++)
+        {
+            FmIndexType fm_index(seq, 1, 2, k);
+            for (auto code = 0; code < (1 << 2 * k); code++)
+            {
+                std::string kmer;
+                for (auto i = k; i-- > 0; )
+                    kmer.push_back("ACGT"[(code >> 2 * i) & 3]);
+                auto range = plain.get_range(kmer);
+                if (range.first >= range.second)
+                    EXPECT_EQ(fm_index.count(kmer), 0);
+                else
+                    EXPECT_EQ(fm_index.get_range(kmer), range)
+                        << "seq size: " << seq.size() << ", " << kmer;
+            }
+        }
+    }
+}
+
+TEST(Construction, ExternalMemory)
+{
+    using FmIndexType = FmIndex<
+        SeqType, uint32_t, 2, SACA_K, BlockOcc, DnaAlphabet>;
+
+    auto seq = random_dna(20000, 2);
+    auto sa = naive_sa(seq, DnaAlphabet());
+
+    // budgets of a few elements per buffer up to a whole bucket
+    TempDir dir;
+    for (std::size_t budget : {0, 1000, 40000})
+    {
+        ExternalMemory external;
+        external.scratch_dir = dir.path();
+        external.sa_budget = budget;
+        check_locations(FmIndexType(seq, 4, 1, 0, external), sa);
+    }
+}
+
+TEST(Construction, Index64)
+{
+    using FmIndexType = FmIndex<
+        SeqType, uint64_t, 2, SACA_K, BlockOcc, DnaAlphabet>;
+    using Packed40FmIndexType = FmIndex<SeqType, uint64_t, 2, SACA_K
+      , BlockOcc, DnaAlphabet, Int40Vector>;
+    using Sampled40FmIndexType = FmIndex<SeqType, uint64_t, 2, SACA_K
+      , SampledOcc, DnaAlphabet, Int40Vector>;
+
+    auto seq = random_dna(20000, 3);
+    auto sa = naive_sa(seq, DnaAlphabet());
+
+    FmIndexType fm_index(seq, 4);
+    check_locations(fm_index, sa);
+    for (auto threads : {1, 2})
+    {
+        check_locations(Packed40FmIndexType(seq, 4, threads), sa);
+        check_locations(Sampled40FmIndexType(seq, 8, threads), sa);
+    }
+
+    TempDir dir;
+    ExternalMemory external;
+    external.scratch_dir = dir.path();
+    external.sa_budget = 1000;
+    check_locations(Packed40FmIndexType(seq, 4, 1, 0, external), sa);
+
+    auto path = dir.file("fm_index_64.bin");
+    fm_index.save(path);
+    check_locations(FmIndexType::load(path), sa);
+    // index width is checked
+    using FmIndex32Type = FmIndex<
+        SeqType, uint32_t, 2, SACA_K, BlockOcc, DnaAlphabet>;
+    EXPECT_THROW(FmIndex32Type::load(path), std::runtime_error);
+}
+
+TEST(Construction, TooLongForIndex)
+{
+    using FmIndexType = FmIndex<
+        SeqType, uint8_t, 2, SACA_K, BlockOcc, DnaAlphabet>;
+    SeqType seq(300, 'C');
+    seq.back() = 'A';
+    EXPECT_THROW(FmIndexType fm_index(seq), std::runtime_error);
+}
+
+TEST(Construction, BuildStats)
+{
+    using FmIndexType = FmIndex<
+        SeqType, uint32_t, 2, SACA_K, BlockOcc, DnaAlphabet>;
+
+    auto seq = random_dna(20000, 4);
+
+    BuildStats stats, unused;
+    {
+        BuildStats::Scope scope(stats);
+        check_locations(FmIndexType(seq, 4)
+                      , naive_sa(seq, DnaAlphabet()));
+    }
+    FmIndexType fm_index(seq, 4);
+    EXPECT_TRUE(unused.phases().empty());
+    EXPECT_FALSE(BuildStats::enabled());
+
+    // top level phases in order, sorter stages nested in "sorter"
+    std::vector<std::string> top;
+    int sorter_phases = 0;
+    for (const auto& phase : stats.phases())
+    {
+        EXPECT_GE(phase.seconds, 0);
+        EXPECT_GT(phase.peak_rss, 0);
+        if (phase.depth == 0)
+            top.push_back(phase.name);
+        else if (phase.name.compare(0, 7, "saca_k.") == 0)
+        {
+            EXPECT_GE(phase.level, 0);
+            sorter_phases++;
+        }
+    }
+    EXPECT_EQ(top, std::vector<std::string>({"type", "count"
+      , "lms_extract", "lms_sort", "naming", "sorter", "lms_positions"
+      , "induce", "sample_locations", "occ", "kmer_table"}));
+    EXPECT_GE(sorter_phases, 3);
+
+    std::map<std::string, double> counters;
+    for (const auto& counter : stats.counters())
+        counters[counter.name] = counter.value;
+    EXPECT_EQ(counters["seq_size"], seq.size());
+    EXPECT_GT(counters["lms_size"], counters["lms_names"]);
+    EXPECT_GE(counters["lms_size"], counters["distinct_lms_size"]);
+    EXPECT_EQ(counters["distinct_lms_ratio"]
+            , counters["distinct_lms_size"] / counters["lms_size"]);
+    EXPECT_GE(counters["saca_k.depth"], 1);
+    EXPECT_EQ(counters["saca_k.level0.size"], counters["lms_size"]);
+
+    std::ostringstream json;
+    stats.write_json(json);
+    EXPECT_NE(json.str().find("\"name\": \"saca_k.induce\"")
+            , std::string::npos);
+    EXPECT_NE(json.str().find("\"distinct_lms_ratio\": ")
+            , std::string::npos);
+}
+
+TEST(Construction, Collection)
+{
+    using FmIndexType = FmIndex<
+        SeqType, uint32_t, 2, SACA_K, BlockOcc, DnaAlphabet>;
+
+    // records of a few characters up to several blocks, some empty
+    std::default_random_engine eng;
+    std::uniform_int_distribution<int> dist(0, 3);
+    std::uniform_int_distribution<int> length(0, 600);
+    std::vector<SeqType> records(40);
+    for (auto& record : records)
+    {
+        record.resize(length(eng) % 3 == 0 ? length(eng) % 4 : length(eng));
+        std::generate(record.begin(), record.end(),
+            [&eng, &dist](){ return "ACGT"[dist(eng)]; });
+    }
+
+    FmIndexType fm_index(records, 'A', 4);
+    TempDir dir;
+    auto path = dir.file("fm_index_collection.bin");
+    fm_index.save(path);
+    auto loaded = FmIndexType::load(path);
+
+    // boundaries found from samples far apart, and with a k-mer table
+    // which count_records() does not seed from
+    FmIndexType sparse(records, 'A', 64);
+    FmIndexType kmer(records, 'A', 1, 1, 3);
+
+    SeqType text;
+    for (const auto& record : records)
+        text += record;
+    text += 'A';
+
+    for (const auto& index : {fm_index, loaded, sparse, kmer})
+    {
+        ASSERT_EQ(index.record_count(), records.size());
+        std::size_t location = 0;
+        for (std::size_t r = 0; r < records.size(); r++)
+            for (std::size_t offset = 0; offset < records[r].size()
+                   ; offset++, location++)
+                ASSERT_EQ(index.to_record(location)
+                        , std::make_pair(r, uint32_t(offset)));
+
+        for (auto len : {1, 2, 3, 8, 12})
+            for (auto i = 0; i < 40; i++)
+            {
+                // random, or taken from the concatenation so that many
+                // occurrences cross records (or reach $)
+                SeqType pattern(len, 'A');
+                std::generate(pattern.begin(), pattern.end(),
+                    [&eng, &dist](){ return "ACGT"[dist(eng)]; });
+                if (i % 2)
+                    pattern = text.substr(
+                        eng() % (text.size() - len + 1), len);
+
+                std::vector<std::pair<std::size_t, uint32_t>> ans;
+                for (std::size_t r = 0; r < records.size(); r++)
+                    for (auto pos = records[r].find(pattern)
+                       ; pos != SeqType::npos
+                       ; pos = records[r].find(pattern, pos + 1))
+                        ans.emplace_back(r, pos);
+                auto hits = index.locate_records(pattern);
+                std::sort(hits.begin(), hits.end());
+                EXPECT_EQ(hits, ans) << pattern;
+                EXPECT_EQ(index.count_records(pattern), ans.size());
+                EXPECT_GE(index.count(pattern), ans.size());
+            }
+    }
+
+    // a single seq is one record, $ excluded
+    SeqType seq("CAGTA");
+    FmIndexType single(seq);
+    EXPECT_EQ(single.record_count(), 1);
+    EXPECT_EQ(single.to_record(3), std::make_pair(std::size_t(0), 3u));
+    EXPECT_EQ(single.locate_records(SeqType("TA")).size(), 0);
+    EXPECT_EQ(single.locate_records(SeqType("GT")).size(), 1);
+    EXPECT_EQ(single.count_records(SeqType("TA")), 0);
+    EXPECT_EQ(single.count_records(SeqType("GT")), 1);
+}
+
+TEST(Construction, WideAlphabet)
+{
+    // 5 characters in 3 bits, ranks are not in ascii order
+    auto map = [](char c) -> uint32_t
+    { return std::string("EDCBA").find(c); };
+    using FmIndexType = FmIndex<SeqType, uint32_t, 3, SACA_K>;
+
+    std::default_random_engine eng;
+    std::uniform_int_distribution<int> dist(0, 4);
+    for (auto len : {10, 100, 3000})
+    {
+        SeqType seq(len, 'E');
+        std::generate(seq.begin(), seq.end()-1,
+            [&eng, &dist](){ return "ABCDE"[dist(eng)]; });
+        check_locations(FmIndexType(seq, map, 2), naive_sa(seq, map));
+    }
+}
+
+TEST(Construction, WaveletOccByteText)
+{
+    // bytes, $ being 0, with runs and a skewed distribution
+    auto map = [](char c) -> uint32_t { return uint8_t(c); };
+    using FmIndexType = FmIndex<SeqType, uint32_t, 8, SACA_K, WaveletOcc>;
+    using BlockFmIndexType = FmIndex<SeqType, uint32_t, 8, SACA_K>;
+
+    std::default_random_engine eng;
+    std::geometric_distribution<int> dist(0.05);
+    SeqType seq(5000, '\0');
+    std::generate(seq.begin(), seq.end()-1,
+        [&eng, &dist](){ return char(1 + dist(eng) % 255); });
+    for (auto i = 1000; i < 1500; i++)
+        seq[i] = 'x';
+
+    FmIndexType fm_index(seq, map, 4, 2);
+    check_locations(fm_index, naive_sa(seq, map));
+
+    BlockFmIndexType block_index(seq, map, 4);
+    std::uniform_int_distribution<std::size_t> pos(0, seq.size() - 20);
+    for (auto i = 0; i < 200; i++)
+    {
+        auto pattern = seq.substr(pos(eng), 1 + i % 6);
+        EXPECT_EQ(fm_index.count(pattern), block_index.count(pattern));
+    }
+
+    TempDir dir;
+    auto path = dir.file("fm_index_wavelet.bin");
+    fm_index.save(path);
+    auto loaded = FmIndexType::load(path, map);
+    check_locations(loaded, naive_sa(seq, map));
+    EXPECT_THROW(BlockFmIndexType::load(path, map), std::runtime_error);
+}
+
+/// @brief Edit distance of pattern and text, the first and last
+///        characters of text aligned to pattern characters (matched or
+///        substituted), as an approximate match is not extended by
+///        deleting text at its ends
+unsigned match_distance(const SeqType& pattern, const SeqType& text)
+{
+    auto m = pattern.size(), n = text.size();
+    std::vector<std::vector<unsigned>> dist(
+        m + 1, std::vector<unsigned>(n + 1, m + n));
+    for (std::size_t i = 0; i <= m; i++)
+        for (std::size_t j = 0; j <= n; j++)
+        {
+            if (i == 0 && j == 0)
+                dist[i][j] = 0;
+            if (i > 0)
+                dist[i][j] = std::min(dist[i][j], dist[i-1][j] + 1);
+            if (j > 1 && j < n)
+                dist[i][j] = std::min(dist[i][j], dist[i][j-1] + 1);
+            if (i > 0 && j > 0)
+                dist[i][j] = std::min(dist[i][j], dist[i-1][j-1]
+                    + (pattern[i-1] != text[j-1]));
+        }
+    return dist[m][n];
+}
+
+/// @brief Bwt interval and distance of every distinct substring of
+///        seq within k of pattern, by mismatches or match_distance()
+template<class FM_INDEX>
+std::vector<std::tuple<uint32_t, uint32_t, unsigned>> naive_approx(
+    const FM_INDEX& fm_index, const SeqType& seq
+  , const SeqType& pattern, unsigned k, bool edit)
+{
+    std::map<std::pair<uint32_t, uint32_t>, unsigned> best;
+    auto m = pattern.size();
+    auto text = seq.substr(0, seq.size() - 1);
+    for (std::size_t pos = 0; pos < text.size(); pos++)
+        for (auto len = edit ? m - std::min<std::size_t>(k, m - 1) : m
+               ; len <= (edit ? m + k : m) && pos + len <= text.size()
+               ; len++)
+        {
+            auto sub = text.substr(pos, len);
+            unsigned dist = 0;
+            if (edit)
+                dist = match_distance(pattern, sub);
+            else
+                for (std::size_t i = 0; i < m; i++)
+                    dist += pattern[i] != sub[i];
+            if (dist > k)
+                continue;
+            auto range = fm_index.get_range(sub);
+            auto found = best.find(range);
+            if (found == best.end() || found->second > dist)
+                best[range] = dist;
+        }
+    std::vector<std::tuple<uint32_t, uint32_t, unsigned>> ans;
+    for (const auto& hit : best)
+        ans.emplace_back(hit.first.first, hit.first.second, hit.second);
+    return ans;
+}
+
+template<class RANGES>
+std::vector<std::tuple<uint32_t, uint32_t, unsigned>> to_tuples(
+    const RANGES& ranges)
+{
+    std::vector<std::tuple<uint32_t, uint32_t, unsigned>> tuples;
+    for (const auto& range : ranges)
+        tuples.emplace_back(range.begin, range.end, range.errors);
+    return tuples;
+}
+
+TEST(Search, Approximate)
+{
+    using FmIndexType = FmIndex<
+        SeqType, uint32_t, 2, SACA_K, BlockOcc, DnaAlphabet>;
+
+    auto seq = random_dna(800, 6);
+    std::default_random_engine eng;
+    std::uniform_int_distribution<int> dist(0, 3);
+    FmIndexType fm_index(seq, 4);
+
+    // substrings of seq with a few changes, and random patterns
+    std::uniform_int_distribution<std::size_t> pos(0, seq.size() - 20);
+    for (auto i = 0; i < 40; i++)
+    {
+        auto len = 4 + i % 9;
+        auto pattern = seq.substr(pos(eng), len);
+        for (auto e = 0; e < i % 3; e++)
+            pattern[dist(eng) % len] = "ACGT"[dist(eng)];
+        if (i % 5 == 0)
+            pattern.erase(pattern.begin() + dist(eng));
+        for (unsigned k = 0; k <= 2; k++)
+        {
+            EXPECT_EQ(to_tuples(fm_index.search_mismatch(pattern, k))
+                    , naive_approx(fm_index, seq, pattern, k, false))
+                << pattern << ", k: " << k;
+            EXPECT_EQ(to_tuples(fm_index.search_edit(pattern, k))
+                    , naive_approx(fm_index, seq, pattern, k, true))
+                << pattern << ", k: " << k;
+        }
+    }
+}
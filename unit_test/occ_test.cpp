@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+#include "sampled_occ.hpp"
+#include "block_occ.hpp"
+#include "wavelet_occ.hpp"
+
+// Build OCC on a random bwt of size n and compare every occ() and
+// access against naive counting
+template<template<typename, int> class OCC, typename INDEX, int BITS>
+void check_occ(std::size_t n, int sample_rate = 16, unsigned threads = 1)
+{
+    std::default_random_engine eng(n);
+    std::uniform_int_distribution<int> dist(0, (1 << BITS) - 1);
+    PackedVector<BITS> bwt(n);
+    std::vector<int> ans(n);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        ans[i] = dist(eng);
+        bwt.set(i, ans[i]);
+    }
+    INDEX primary_index = n / 3;
+
+    OCC<INDEX, BITS> occ(bwt, primary_index, sample_rate, threads);
+    ASSERT_EQ(occ.size(), n);
+
+    std::vector<INDEX> count(1 << BITS);
+    for (std::size_t i = 0; i <= n; i++)
+    {
+        for (std::size_t c = 0; c < count.size(); c++)
+            ASSERT_EQ(occ.occ(i, c), count[c])
+                << "i: " << i << ", c: " << c;
+        if (i == n)
+            break;
+        if (i != primary_index)
+        {
+            EXPECT_EQ(occ[i], ans[i]);
+            count[ans[i]]++;
+        }
+    }
+}
+
+TEST(SampledOcc, RandomBwt)
+{
+    check_occ<SampledOcc, uint32_t, 2>(1000, 1);
+    check_occ<SampledOcc, uint32_t, 2>(1000, 16);
+    check_occ<SampledOcc, uint64_t, 3>(777, 32);
+    check_occ<SampledOcc, uint8_t, 2>(200, 4);
+}
+
+TEST(SampledOcc, Threads)
+{
+    check_occ<SampledOcc, uint32_t, 2>(1000, 1, 4);
+    check_occ<SampledOcc, uint32_t, 2>(1000, 16, 3);
+    check_occ<SampledOcc, uint32_t, 2>(10, 16, 4);
+}
+
+TEST(BlockOcc, Layout)
+{
+    // one cache line per block for DNA
+    EXPECT_EQ((BlockOcc<uint32_t, 2>::block_words), 8);
+    EXPECT_EQ((BlockOcc<uint32_t, 2>::block_size), 192);
+    EXPECT_EQ((BlockOcc<uint64_t, 2>::block_size), 128);
+    EXPECT_EQ((BlockOcc<uint8_t, 2>::block_size), 224);
+}
+
+TEST(BlockOcc, RandomBwt)
+{
+    // cover block boundaries: exact multiple, one more, one less
+    check_occ<BlockOcc, uint32_t, 2>(192 * 5);
+    check_occ<BlockOcc, uint32_t, 2>(192 * 5 + 1);
+    check_occ<BlockOcc, uint32_t, 2>(192 * 5 - 1);
+    check_occ<BlockOcc, uint64_t, 2>(1000);
+    check_occ<BlockOcc, uint8_t, 2>(250);
+    // wider alphabets, including fields not filling a word
+    check_occ<BlockOcc, uint32_t, 3>(2000);
+    check_occ<BlockOcc, uint32_t, 4>(3000);
+    check_occ<BlockOcc, uint32_t, 5>(3000);
+    check_occ<BlockOcc, uint32_t, 8>(5000);
+}
+
+TEST(BlockOcc, Threads)
+{
+    check_occ<BlockOcc, uint32_t, 2>(192 * 7 + 5, 1, 3);
+    check_occ<BlockOcc, uint32_t, 2>(192 * 2, 1, 8);
+    check_occ<BlockOcc, uint32_t, 3>(5000, 1, 4);
+}
+
+TEST(WaveletOcc, RandomBwt)
+{
+    check_occ<WaveletOcc, uint32_t, 2>(1000);
+    check_occ<WaveletOcc, uint32_t, 2>(RankBitVector::block_bits * 3);
+    check_occ<WaveletOcc, uint64_t, 3>(777);
+    check_occ<WaveletOcc, uint8_t, 2>(200);
+    check_occ<WaveletOcc, uint32_t, 5>(3000);
+    check_occ<WaveletOcc, uint32_t, 8>(5000);
+    check_occ<WaveletOcc, uint32_t, 1>(100);
+}
+
+TEST(WaveletOcc, Threads)
+{
+    check_occ<WaveletOcc, uint32_t, 2>(5000, 1, 3);
+    check_occ<WaveletOcc, uint32_t, 5>(RankBitVector::block_bits * 4 + 1
+                                     , 1, 4);
+    check_occ<WaveletOcc, uint32_t, 2>(10, 1, 4);
+}
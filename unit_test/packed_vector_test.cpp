@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include "packed_vector.hpp"
+
+template<int BITS>
+void check_random_set_get(std::size_t n)
+{
+    std::default_random_engine eng;
+    std::uniform_int_distribution<uint64_t> dist(
+        0, PackedVector<BITS>::mask);
+
+    std::vector<uint64_t> ans(n);
+    PackedVector<BITS> vec(n);
+    ASSERT_EQ(vec.size(), n);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        ans[i] = dist(eng);
+        vec.set(i, ans[i]);
+    }
+    // overwrite some elements, neighbors must be kept
+    for (std::size_t i = 0; i < n; i += 7)
+    {
+        ans[i] = dist(eng);
+        vec.set(i, ans[i]);
+    }
+
+    for (std::size_t i = 0; i < n; i++)
+        EXPECT_EQ(vec[i], ans[i]) << "index: " << i;
+}
+
+TEST(PackedVector, SetGet)
+{
+    check_random_set_get<1>(1000);
+    check_random_set_get<2>(1000);
+    check_random_set_get<3>(1000); // 21 per word, 1 bit unused
+    check_random_set_get<5>(999);
+    check_random_set_get<8>(1001);
+}
+
+TEST(PackedVector, WordSize)
+{
+    PackedVector<2> vec(65);
+    EXPECT_EQ(vec.words().size(), 3);
+    vec.resize(64);
+    EXPECT_EQ(vec.words().size(), 2);
+}
+
+TEST(IntVector, SetGet)
+{
+    std::default_random_engine eng;
+    for (auto width : {1, 7, 17, 31, 33, 63, 64})
+    {
+        IntVector vec(1000, width);
+        ASSERT_EQ(vec.width(), width);
+        std::uniform_int_distribution<uint64_t> dist(
+            0, (width == 64) ? ~uint64_t(0) : (uint64_t(1) << width) - 1);
+        std::vector<uint64_t> ans(vec.size());
+        for (std::size_t i = 0; i < vec.size(); i++)
+        {
+            ans[i] = dist(eng);
+            vec.set(i, ans[i]);
+        }
+        // overwrite some elements, neighbors must be kept
+        for (std::size_t i = 0; i < vec.size(); i += 7)
+        {
+            ans[i] = dist(eng);
+            vec.set(i, ans[i]);
+        }
+        for (std::size_t i = 0; i < vec.size(); i++)
+            EXPECT_EQ(vec[i], ans[i]) << "width: " << width 
+                                      << ", index: " << i;
+    }
+}
+
+TEST(IntVector, BitWidth)
+{
+    EXPECT_EQ(IntVector::bit_width(0), 1);
+    EXPECT_EQ(IntVector::bit_width(1), 1);
+    EXPECT_EQ(IntVector::bit_width(2), 2);
+    EXPECT_EQ(IntVector::bit_width(255), 8);
+    EXPECT_EQ(IntVector::bit_width(256), 9);
+    EXPECT_EQ(IntVector::bit_width(~uint64_t(0)), 64);
+}
+
+TEST(Int40Vector, SetGet)
+{
+    std::default_random_engine eng;
+    // values in [-2^39, 2^39) as uint64_t
+    std::uniform_int_distribution<int64_t> dist(
+        -(int64_t(1) << 39), (int64_t(1) << 39) - 1);
+    Int40Vector vec(1000);
+    ASSERT_EQ(vec.size(), 1000);
+    ASSERT_EQ(element_bits<Int40Vector>(), 40);
+    ASSERT_EQ(element_bits<std::vector<uint32_t>>(), 32);
+
+    std::vector<uint64_t> ans(vec.size());
+    for (std::size_t i = 0; i < vec.size(); i++)
+        vec[i] = ans[i] = dist(eng);
+    vec[0] = ans[0] = (uint64_t(1) << 39) - 1;
+    vec[1] = ans[1] = -(int64_t(1) << 39);
+    vec[2] = ans[2] = -1;
+    for (std::size_t i = 0; i < vec.size(); i++)
+        EXPECT_EQ(vec[i], ans[i]) << "index: " << i;
+
+    // proxies assign values, iterators walk 5 bytes
+    vec[3] = vec[4];
+    vec[5]++;
+    ans[3] = ans[4];
+    ans[5]++;
+    std::swap(ans[6], ans[7]);
+    std::iter_swap(vec.begin() + 6, vec.begin() + 7);
+    const auto& const_vec = vec;
+    EXPECT_TRUE(std::equal(ans.begin(), ans.end(), const_vec.begin()));
+    EXPECT_EQ(const_vec.end() - const_vec.begin(), vec.size());
+
+    std::sort(vec.begin(), vec.end());
+    std::sort(ans.begin(), ans.end());
+    EXPECT_TRUE(std::equal(ans.begin(), ans.end(), vec.begin()));
+}
+
+TEST(Int40Vector, SignExtend)
+{
+    // bit 39 is copied to the bits above, the bits below are kept
+    Int40Vector vec(4);
+    vec[0] = uint64_t(1) << 39;
+    vec[1] = (uint64_t(1) << 40) - 1;
+    vec[2] = (uint64_t(1) << 39) | 0x12345678;
+    vec[3] = (uint64_t(1) << 39) - 1;
+    EXPECT_EQ(vec[0], 0xffffff8000000000);
+    EXPECT_EQ(vec[1], ~uint64_t(0));
+    EXPECT_EQ(vec[2], 0xffffff8012345678);
+    EXPECT_EQ(vec[3], 0x7fffffffff);
+}
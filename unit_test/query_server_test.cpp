@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "fm_index.hpp"
+#include "query_server.hpp"
+#include "saca_k.hpp"
+#include "test_util.hpp"
+
+using SeqType = std::string;
+using FmIndexType = FmIndex<
+    SeqType, uint32_t, 2, SACA_K, BlockOcc, DnaAlphabet>;
+
+TEST(QueryServer, CountAndLocate)
+{
+    auto seq = random_dna(20000, 9);
+    FmIndexType index(seq, 8);
+
+    TempDir dir;
+    const auto path = dir.file("query_server_test.sock");
+    QueryServer<FmIndexType> server(index, path, 3);
+    std::thread server_thread([&server]{ server.run(); });
+
+    // more clients than workers, each sending several batches
+    std::vector<std::thread> clients;
+    std::vector<int> failures(6, 0);
+    for (auto c = 0; c < 6; c++)
+        clients.emplace_back([&, c]
+        {
+            std::default_random_engine eng(c);
+            std::uniform_int_distribution<std::size_t> pos(0, seq.size() - 20);
+            std::uniform_int_distribution<std::size_t> len(1, 12);
+            QueryClient client(path);
+            for (auto batch = 0; batch < 20; batch++)
+            {
+                std::vector<SeqType> patterns(batch);
+                for (auto& pattern : patterns)
+                    pattern = seq.substr(pos(eng), len(eng));
+                if (batch % 2)
+                {
+                    auto counts = client.count(patterns);
+                    for (std::size_t i = 0; i < patterns.size(); i++)
+                        failures[c] += counts[i] != index.count(patterns[i]);
+                }
+                else
+                {
+                    auto locations = client.locate(patterns);
+                    for (std::size_t i = 0; i < patterns.size(); i++)
+                    {
+                        auto expect = index.locate(patterns[i]);
+                        failures[c] += !std::equal(
+                            expect.begin(), expect.end()
+                          , locations[i].begin(), locations[i].end());
+                    }
+                }
+            }
+        });
+    for (auto& client : clients)
+        client.join();
+    EXPECT_EQ(failures, std::vector<int>(6, 0));
+
+    // a malformed request is rejected and its connection closed, the
+    // server keeps serving others
+    {
+        QueryClient client(path);
+        std::vector<SeqType> too_long {
+            SeqType(QueryProtocol::max_length + 1, 'A')};
+        EXPECT_THROW(client.count(too_long), std::runtime_error);
+        EXPECT_THROW(client.count(std::vector<SeqType>{"A"})
+                   , std::runtime_error);
+    }
+    QueryClient client(path);
+    EXPECT_EQ(client.count(std::vector<SeqType>{"", "ACG"})
+            , std::vector<uint64_t>({index.count(SeqType())
+                                   , index.count(SeqType("ACG"))}));
+
+    server.stop();
+    server_thread.join();
+}
+
+TEST(QueryServer, StalledClient)
+{
+    auto seq = random_dna(5000, 10);
+    FmIndexType index(seq, 8);
+
+    TempDir dir;
+    const auto path = dir.file("query_server_stall.sock");
+    QueryServer<FmIndexType> server(index, path, 1);
+    std::thread server_thread([&server]{ server.run(); });
+
+    // a client sending half a request and then nothing must not hold
+    // the only worker
+    auto addr = QueryProtocol::socket_address(path);
+    int stalled = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    ASSERT_EQ(::connect(stalled, reinterpret_cast<sockaddr*>(&addr)
+                      , sizeof(addr)), 0);
+    QueryProtocol::RequestHeader request {QueryProtocol::count, 2};
+    uint32_t length = 3;
+    ASSERT_TRUE(QueryProtocol::write_full(stalled, &request
+                                        , sizeof(request)));
+    ASSERT_TRUE(QueryProtocol::write_full(stalled, &length
+                                        , sizeof(length)));
+
+    QueryClient client(path);
+    std::vector<SeqType> patterns {"ACG", "T", seq.substr(100, 15)};
+    for (auto i = 0; i < 3; i++)
+    {
+        auto counts = client.count(patterns);
+        ASSERT_EQ(counts.size(), patterns.size());
+        for (std::size_t p = 0; p < patterns.size(); p++)
+            EXPECT_EQ(counts[p], index.count(patterns[p]));
+    }
+
+    // stop() returns with the stalled client still connected
+    server.stop();
+    server_thread.join();
+    ::close(stalled);
+}
+
+TEST(QueryServer, PipelinedClient)
+{
+    auto seq = random_dna(5000, 11);
+    FmIndexType index(seq, 8);
+
+    TempDir dir;
+    const auto path = dir.file("query_server_pipe.sock");
+    QueryServer<FmIndexType> server(index, path, 1);
+    std::thread server_thread([&server]{ server.run(); });
+
+    // more requests than max_request bytes written at once, answers
+    // read only afterwards: the server buffers at most max_request of
+    // them and still serves other clients
+    std::vector<SeqType> patterns {
+        random_dna(1000, 12), seq.substr(100, 15)};
+    std::vector<char> requests;
+    constexpr std::size_t count = 140000;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const auto& pattern = patterns[i % 2];
+        QueryProtocol::append(requests, QueryProtocol::RequestHeader {
+            QueryProtocol::count, 1});
+        QueryProtocol::append(requests, uint32_t(pattern.size()));
+        requests.insert(requests.end(), pattern.begin(), pattern.end());
+    }
+    ASSERT_GT(requests.size(), uint64_t(QueryProtocol::max_request));
+
+    auto addr = QueryProtocol::socket_address(path);
+    int pipelined = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    ASSERT_EQ(::connect(pipelined, reinterpret_cast<sockaddr*>(&addr)
+                      , sizeof(addr)), 0);
+    std::thread writer([&]
+        {
+            QueryProtocol::write_full(
+                pipelined, requests.data(), requests.size());
+        });
+
+    QueryClient client(path);
+    EXPECT_EQ(client.count(patterns)
+            , std::vector<uint64_t>({index.count(patterns[0])
+                                   , index.count(patterns[1])}));
+
+    std::size_t failures = 0;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        QueryProtocol::ResponseHeader response;
+        uint64_t result;
+        ASSERT_TRUE(QueryProtocol::read_full(
+            pipelined, &response, sizeof(response)));
+        ASSERT_TRUE(QueryProtocol::read_full(
+            pipelined, &result, sizeof(result)));
+        failures += response.status != QueryProtocol::ok
+                 || response.results != 1
+                 || result != index.count(patterns[i % 2]);
+    }
+    EXPECT_EQ(failures, 0u);
+    writer.join();
+    ::close(pipelined);
+
+    server.stop();
+    server_thread.join();
+}
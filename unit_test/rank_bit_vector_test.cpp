@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+#include "rank_bit_vector.hpp"
+
+TEST(RankBitVector, Rank)
+{
+    std::default_random_engine eng;
+    // cover block boundaries and sparse / dense vectors
+    for (std::size_t n : {0, 1, 447, 448, 449, 5000})
+        for (auto density : {0.0, 0.05, 0.5, 1.0})
+        {
+            std::bernoulli_distribution dist(density);
+            std::vector<bool> ans(n);
+            RankBitVector bits(n);
+            ASSERT_EQ(bits.size(), n);
+            for (std::size_t i = 0; i < n; i++)
+                if ((ans[i] = dist(eng)))
+                    bits.set(i);
+            bits.init_rank();
+
+            std::size_t rank = 0;
+            for (std::size_t i = 0; i <= n; i++)
+            {
+                ASSERT_EQ(bits.rank(i), rank) << "n: " << n 
+                                              << ", i: " << i;
+                if (i == n)
+                    break;
+                EXPECT_EQ(bits[i], ans[i]);
+                rank += ans[i];
+            }
+        }
+}
+
+TEST(RankBitVector, Select)
+{
+    std::default_random_engine eng;
+    // many samples, long runs between samples and all ones / zeros
+    for (std::size_t n : {1, 448, 449, 5000, 300000})
+        for (auto density : {0.0, 0.001, 0.3, 0.999, 1.0})
+        {
+            std::bernoulli_distribution dist(density);
+            std::vector<std::size_t> ones, zeros;
+            RankBitVector bits(n);
+            for (std::size_t i = 0; i < n; i++)
+                if (dist(eng))
+                {
+                    bits.set(i);
+                    ones.push_back(i);
+                }
+                else
+                    zeros.push_back(i);
+            bits.init_rank();
+            bits.init_select();
+
+            for (std::size_t k = 0; k < ones.size(); k++)
+                ASSERT_EQ(bits.select(k), ones[k]) << "n: " << n
+                                                   << ", k: " << k;
+            for (std::size_t k = 0; k < zeros.size(); k++)
+                ASSERT_EQ(bits.select0(k), zeros[k]) << "n: " << n
+                                                     << ", k: " << k;
+        }
+}
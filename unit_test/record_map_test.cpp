@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+#include "record_map.hpp"
+
+/// @brief Check every position against the lengths
+void check_records(const RecordMap& records
+                 , const std::vector<uint64_t>& lengths)
+{
+    ASSERT_EQ(records.count(), lengths.size());
+    uint64_t pos = 0;
+    for (std::size_t r = 0; r < lengths.size(); r++)
+    {
+        ASSERT_EQ(records.length(r), lengths[r]) << "record: " << r;
+        for (uint64_t offset = 0; offset < lengths[r]; offset++, pos++)
+        {
+            ASSERT_EQ(records.to_record(pos), std::make_pair(r, offset))
+                << "pos: " << pos;
+
+            // matches up to the record end, not beyond it
+            std::size_t record;
+            uint64_t match_offset;
+            auto len = lengths[r] - offset;
+            ASSERT_TRUE(records.locate(pos, len, record, match_offset));
+            EXPECT_EQ(record, r);
+            EXPECT_EQ(match_offset, offset);
+            EXPECT_FALSE(records.locate(pos, len + 1, record
+                                      , match_offset));
+        }
+    }
+    EXPECT_EQ(records.size(), pos);
+}
+
+TEST(RecordMap, Lengths)
+{
+    check_records(RecordMap({1}), {1});
+    check_records(RecordMap({100}), {100});
+    check_records(RecordMap({1, 1, 1, 2}), {1, 1, 1, 2});
+    check_records(RecordMap({0, 3, 0, 0, 5, 0}), {0, 3, 0, 0, 5, 0});
+    check_records(RecordMap(std::vector<uint64_t>()), {});
+}
+
+TEST(RecordMap, Random)
+{
+    std::default_random_engine eng;
+    // many short records and few long ones
+    for (auto max_len : {3, 40, 5000})
+    {
+        std::uniform_int_distribution<uint64_t> dist(0, max_len);
+        std::vector<uint64_t> lengths(20000 / max_len + 5);
+        for (auto& len : lengths)
+            len = dist(eng);
+        check_records(RecordMap(lengths), lengths);
+    }
+}
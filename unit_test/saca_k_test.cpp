@@ -4,6 +4,7 @@
 #include <chrono>
 #include <algorithm>
 #include "saca_k.hpp"
+#include "packed_vector.hpp"
 
 template<class SEQ, class SA>
 bool sa_is_correct(const SEQ& seq, const SA& sa, int k)
@@ -331,6 +332,26 @@ TEST(SACA_K, EasyTwoLevel2)
     EXPECT_TRUE(sa_is_correct(seq, sa, alphabet_size));
 }
 
+TEST(SACA_K, RandomSmall)
+{
+    // short seqs over small alphabets hit every corner of the
+    // recursion (e.g. a suffix put back to its own slot)
+    std::default_random_engine eng;
+    for (auto k = 2; k <= 4; k++)
+        for (auto len = 2; len <= 64; len++)
+            for (auto t = 0; t < 20; t++)
+            {
+                std::string seq(len, 0);
+                std::uniform_int_distribution<int> dist(1, k - 1);
+                std::generate(seq.begin(), seq.end()-1,
+                    [&eng, &dist](){ return dist(eng); });
+                std::vector<uint32_t> sa(seq.size());
+                SACA_K<decltype(seq), decltype(sa)> sa_builder;
+                sa_builder.build(seq, sa, k);
+                ASSERT_TRUE(sa_is_correct(seq, sa, k));
+            }
+}
+
 TEST(SACA_K, PerformanceTest1MB)
 {
     uint32_t length = 1024*1024;
@@ -356,3 +377,71 @@ TEST(SACA_K, PerformanceTest1MB)
               << elapsed.count() << "s\n";
     EXPECT_TRUE(sa_is_correct(seq, sa, 4));
 }
+
+TEST(SACA_K, ParallelSameAsSequential)
+{
+    // small blocks so that induction crosses many block boundaries
+    std::default_random_engine eng;
+    for (auto k = 2; k <= 4; k++)
+        for (auto len : {2, 3, 17, 100, 1000, 20000})
+        {
+            std::vector<char> seq(len, 0);
+            std::uniform_int_distribution<int> dist(1, k - 1);
+            std::generate(seq.begin(), seq.end()-1,
+                [&eng, &dist](){ return dist(eng); });
+
+            std::vector<uint32_t> expect(seq.size());
+            SACA_K<decltype(seq), decltype(expect)> sa_builder;
+            sa_builder.build(seq, expect, k);
+
+            for (auto threads : {2, 5})
+                for (auto block_size : {3, 256, 1 << 20})
+                {
+                    std::vector<uint32_t> sa(seq.size());
+                    SACA_K<decltype(seq), decltype(sa)> 
+                        parallel_builder(threads, block_size);
+                    parallel_builder.build(seq, sa, k);
+                    ASSERT_EQ(sa, expect) << "len " << len
+                        << ", threads " << threads
+                        << ", block size " << block_size;
+                }
+        }
+}
+
+TEST(SACA_K, WideIndex)
+{
+    // 64-bit and packed 40-bit SA give the same result as 32-bit,
+    // also as the seq of the reduced problem
+    std::default_random_engine eng;
+    for (auto k = 2; k <= 4; k++)
+        for (auto len : {2, 17, 1000, 20000})
+        {
+            std::vector<uint32_t> seq(len, 0);
+            std::uniform_int_distribution<int> dist(1, k - 1);
+            std::generate(seq.begin(), seq.end()-1,
+                [&eng, &dist](){ return dist(eng); });
+
+            std::vector<uint32_t> expect(seq.size());
+            SACA_K<decltype(seq), decltype(expect)> sa_builder;
+            sa_builder.build(seq, expect, k);
+
+            Int40Vector seq40(seq.size());
+            std::copy(seq.begin(), seq.end(), seq40.begin());
+            for (auto threads : {1, 2})
+            {
+                std::vector<uint64_t> sa64(seq.size());
+                SACA_K<decltype(seq), decltype(sa64)>(threads, 256)
+                    .build(seq, sa64, k);
+                ASSERT_TRUE(std::equal(
+                    expect.begin(), expect.end(), sa64.begin()))
+                    << "uint64_t, len " << len << ", threads " << threads;
+
+                Int40Vector sa40(seq.size());
+                SACA_K<Int40Vector, Int40Vector>(threads, 256)
+                    .build(seq40, sa40, k);
+                ASSERT_TRUE(std::equal(
+                    expect.begin(), expect.end(), sa40.begin()))
+                    << "Int40Vector, len " << len << ", threads " << threads;
+            }
+        }
+}
@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include "sequence_file.hpp"
+#include "test_util.hpp"
+
+/// @brief Write content to a file in a temporary directory, both
+///        removed at the end of the scope
+struct TempFile
+{
+    TempDir     dir;
+    std::string path;
+
+    TempFile(const std::string& name, const std::string& content)
+        : path(dir.file(name))
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        ofs << content;
+    }
+};
+
+constexpr DnaEncoding dna_chars = make_dna_encoding('A', 'C', 'G', 'T');
+
+std::string read_seq(const SequenceFile& file)
+{
+    return std::string(file.seq().begin(), file.seq().end());
+}
+
+TEST(SequenceFile, Fasta)
+{
+    TempFile fasta("seq_test.fa",
+        ">chr1 first record\nACGT\nacgt\r\nAC\n"
+        ">chr2\n\nGGTT\n"
+        ">empty\n"
+        ">chr3\nT");
+    for (auto threads : {1, 3})
+    {
+        SequenceFile file(fasta.path, dna_chars, threads);
+        EXPECT_EQ(read_seq(file), "ACGTACGTACGGTTTA");
+        const auto& records = file.records();
+        ASSERT_EQ(records.size(), 4);
+        EXPECT_EQ(records[0].name, "chr1");
+        EXPECT_EQ(records[0].begin, 0);
+        EXPECT_EQ(records[0].length, 10);
+        EXPECT_EQ(records[1].name, "chr2");
+        EXPECT_EQ(records[1].begin, 10);
+        EXPECT_EQ(records[1].length, 4);
+        EXPECT_EQ(records[2].name, "empty");
+        EXPECT_EQ(records[2].length, 0);
+        EXPECT_EQ(records[3].name, "chr3");
+        EXPECT_EQ(records[3].begin, 14);
+        EXPECT_EQ(records[3].length, 1);
+    }
+}
+
+TEST(SequenceFile, Fastq)
+{
+    TempFile fastq("seq_test.fq",
+        "@read1 desc\nACGT\n+\nIIII\n"
+        "@read2\nttgca\n+read2\n@@@@@\n");
+    SequenceFile file(fastq.path, make_dna_encoding(0, 1, 2, 3));
+    EXPECT_EQ(file.seq(), std::vector<char>({0, 1, 2, 3, 3, 3, 2, 1, 0, 0}));
+    ASSERT_EQ(file.records().size(), 2);
+    EXPECT_EQ(file.records()[1].name, "read2");
+    EXPECT_EQ(file.records()[1].begin, 4);
+    EXPECT_EQ(file.records()[1].length, 5);
+
+    TempFile broken("seq_test_broken.fq", "@read1\nACGT\nIIII\n");
+    EXPECT_THROW(SequenceFile(broken.path, dna_chars), std::runtime_error);
+}
+
+TEST(SequenceFile, PlainAndEmpty)
+{
+    TempFile plain("seq_test.txt", "ACG\nTTA\n");
+    SequenceFile file(plain.path, dna_chars);
+    EXPECT_EQ(read_seq(file), "ACGTTAA");
+    ASSERT_EQ(file.records().size(), 1);
+    EXPECT_EQ(file.records()[0].length, 6);
+
+    TempFile empty("seq_test_empty.txt", "");
+    SequenceFile empty_file(empty.path, dna_chars);
+    EXPECT_EQ(read_seq(empty_file), "A");
+    EXPECT_TRUE(empty_file.records().empty());
+
+    EXPECT_THROW(SequenceFile("no_such_file.fa", dna_chars)
+               , std::runtime_error);
+}
+
+TEST(SequenceFile, LargeWithN)
+{
+    // several pieces per record, N replaced the same way whatever
+    // the number of threads
+    std::default_random_engine eng;
+    std::uniform_int_distribution<int> dist(0, 4);
+    std::string content, expect;
+    for (auto r = 0; r < 3; r++)
+    {
+        content += ">r" + std::to_string(r) + "\n";
+        for (auto i = 0; i < 1500000; i++)
+        {
+            auto c = "ACGTN"[dist(eng)];
+            content += c;
+            expect += c;
+            if (i % 80 == 79)
+                content += '\n';
+        }
+        content += '\n';
+    }
+    TempFile fasta("seq_test_large.fa", content);
+
+    SequenceFile file(fasta.path, dna_chars, 1);
+    ASSERT_EQ(file.seq().size(), expect.size() + 1);
+    for (std::size_t i = 0; i < expect.size(); i++)
+    {
+        auto c = file.seq()[i];
+        if (expect[i] == 'N')
+            ASSERT_TRUE(c == 'A' || c == 'C' || c == 'G' || c == 'T');
+        else
+            ASSERT_EQ(c, expect[i]) << "position " << i;
+    }
+    for (auto threads : {2, 4})
+        EXPECT_EQ(SequenceFile(fasta.path, dna_chars, threads).seq()
+                , file.seq());
+}
+
+TEST(SequenceReader, Formats)
+{
+    std::string name, seq;
+    std::istringstream fasta(
+        "\n>q1 first\nACGT\nac\r\n>q2\n>q3\nT\n");
+    SequenceReader fasta_reader(fasta);
+    ASSERT_TRUE(fasta_reader.next(name, seq));
+    EXPECT_EQ(name, "q1");
+    EXPECT_EQ(seq, "ACGTac");
+    ASSERT_TRUE(fasta_reader.next(name, seq));
+    EXPECT_EQ(name, "q2");
+    EXPECT_EQ(seq, "");
+    ASSERT_TRUE(fasta_reader.next(name, seq));
+    EXPECT_EQ(name, "q3");
+    EXPECT_EQ(seq, "T");
+    EXPECT_FALSE(fasta_reader.next(name, seq));
+
+    std::istringstream fastq(
+        "@r1 desc\nACGT\n+\nIIII\n\n@r2\nTTG\n+r2\n@@@\n");
+    SequenceReader fastq_reader(fastq);
+    ASSERT_TRUE(fastq_reader.next(name, seq));
+    EXPECT_EQ(name, "r1");
+    EXPECT_EQ(seq, "ACGT");
+    ASSERT_TRUE(fastq_reader.next(name, seq));
+    EXPECT_EQ(name, "r2");
+    EXPECT_EQ(seq, "TTG");
+    EXPECT_FALSE(fastq_reader.next(name, seq));
+
+    std::istringstream plain("ACG\n\nTT\n");
+    SequenceReader plain_reader(plain);
+    ASSERT_TRUE(plain_reader.next(name, seq));
+    EXPECT_EQ(seq, "ACG");
+    ASSERT_TRUE(plain_reader.next(name, seq));
+    EXPECT_EQ(name, "");
+    EXPECT_EQ(seq, "TT");
+    EXPECT_FALSE(plain_reader.next(name, seq));
+
+    std::istringstream broken("@r1\nACGT\nIIII\n");
+    SequenceReader broken_reader(broken);
+    EXPECT_THROW(broken_reader.next(name, seq), std::runtime_error);
+}
@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <tuple>
+#include "strand_fm_index.hpp"
+#include "saca_k.hpp"
+#include "test_util.hpp"
+
+using SeqType = std::string;
+using StrandFmIndexType = StrandFmIndex<SeqType, uint32_t, SACA_K>;
+using HitTuple = std::tuple<std::size_t, uint32_t, bool>;
+
+SeqType reverse_complement(const SeqType& seq)
+{
+    SeqType rc;
+    for (auto it = seq.rbegin(); it != seq.rend(); ++it)
+        rc.push_back("TGCA"[DnaAlphabet()(*it)]);
+    return rc;
+}
+
+/// @brief Occurrences of pattern, then of its reverse complement, in
+///        each record
+std::vector<HitTuple> naive_locate(
+    const std::vector<SeqType>& records, const SeqType& pattern)
+{
+    std::vector<HitTuple> hits;
+    auto rc = reverse_complement(pattern);
+    for (std::size_t r = 0; r < records.size(); r++)
+        for (std::size_t i = 0; i + pattern.size() <= records[r].size(); i++)
+        {
+            if (records[r].compare(i, pattern.size(), pattern) == 0)
+                hits.emplace_back(r, i, false);
+            if (records[r].compare(i, rc.size(), rc) == 0)
+                hits.emplace_back(r, i, true);
+        }
+    return hits;
+}
+
+std::vector<HitTuple> to_tuples(
+    const std::vector<StrandFmIndexType::Hit>& hits)
+{
+    std::vector<HitTuple> tuples;
+    for (const auto& hit : hits)
+        tuples.emplace_back(hit.record, hit.offset, hit.reverse);
+    std::sort(tuples.begin(), tuples.end());
+    return tuples;
+}
+
+TEST(StrandFmIndex, Locate)
+{
+    std::default_random_engine eng;
+    std::uniform_int_distribution<int> dist(0, 3);
+    std::vector<SeqType> records;
+    for (auto size : {500, 0, 1200, 7, 800})
+    {
+        SeqType record(size, 'A');
+        std::generate(record.begin(), record.end(),
+            [&eng, &dist](){ return "ACGT"[dist(eng)]; });
+        records.push_back(record);
+    }
+    // a record holding the reverse complement of part of another
+    records.push_back(reverse_complement(records[2].substr(100, 300)));
+    StrandFmIndexType index(records, 4);
+    EXPECT_EQ(index.record_count(), records.size());
+
+    std::uniform_int_distribution<int> pick(0, records.size() - 1);
+    for (auto i = 0; i < 300; i++)
+    {
+        const auto& record = records[pick(eng)];
+        std::uniform_int_distribution<std::size_t> len(1, 12);
+        auto m = std::min(len(eng), record.size());
+        if (m == 0)
+            continue;
+        std::uniform_int_distribution<std::size_t> pos(0, record.size() - m);
+        auto pattern = record.substr(pos(eng), m);
+        if (i % 2)
+            pattern = reverse_complement(pattern);
+
+        auto ans = naive_locate(records, pattern);
+        EXPECT_EQ(to_tuples(index.locate(pattern)), ans) << pattern;
+        EXPECT_EQ(index.count(pattern), ans.size()) << pattern;
+    }
+
+    // patterns over the end of a record, found in the concatenation of
+    // the index but not on either strand of a record
+    for (std::size_t r = 0; r + 1 < records.size(); r++)
+        for (std::size_t m : {2, 5, 12})
+        {
+            if (records[r].size() < m)
+                continue;
+            auto pattern = records[r].substr(records[r].size() - m / 2)
+                         + records[r + 1].substr(0, m - m / 2);
+            auto ans = naive_locate(records, pattern);
+            EXPECT_EQ(to_tuples(index.locate(pattern)), ans) << pattern;
+            EXPECT_EQ(index.count(pattern), ans.size()) << pattern;
+            EXPECT_EQ(index.count(reverse_complement(pattern))
+                    , naive_locate(records, reverse_complement(pattern))
+                          .size()) << pattern;
+        }
+
+    // a palindrome has a hit on each strand
+    records = {"CCGAATTCGG"};
+    StrandFmIndexType palindrome(records);
+    EXPECT_EQ(to_tuples(palindrome.locate(SeqType("GAATTC"))),
+        (std::vector<HitTuple>{HitTuple(0, 2, false), HitTuple(0, 2, true)}));
+}
+
+TEST(StrandFmIndex, ApproximateAndLoad)
+{
+    std::default_random_engine eng;
+    std::uniform_int_distribution<int> dist(0, 3);
+    std::vector<SeqType> records(2, SeqType(2000, 'A'));
+    for (auto& record : records)
+        std::generate(record.begin(), record.end(),
+            [&eng, &dist](){ return "ACGT"[dist(eng)]; });
+    StrandFmIndexType index(records, 8);
+
+    // a reverse strand read with a mismatch, found by one search
+    auto pattern = reverse_complement(records[1].substr(700, 30));
+    pattern[10] = pattern[10] == 'A' ? 'C' : 'A';
+    std::vector<HitTuple> hits;
+    for (const auto& range : index.index().search_mismatch(pattern, 1))
+        for (auto location : index.index().locate_range(
+                std::make_pair(range.begin, range.end)))
+        {
+            auto hit = index.to_hit(location, pattern.size());
+            hits.emplace_back(hit.record, hit.offset, hit.reverse);
+        }
+    EXPECT_EQ(hits, std::vector<HitTuple>({HitTuple(1, 700, true)}));
+
+    TempDir dir;
+    index.save(dir.file("strand_test.fmi"));
+    {
+        auto loaded = StrandFmIndexType::load(dir.file("strand_test.fmi"));
+        EXPECT_EQ(loaded.record_count(), 2);
+        auto read = records[0].substr(1500, 20);
+        EXPECT_EQ(to_tuples(loaded.locate(read)), to_tuples(index.locate(read)));
+        EXPECT_EQ(to_tuples(loaded.locate(reverse_complement(read))),
+            std::vector<HitTuple>({HitTuple(0, 1500, true)}));
+    }
+}
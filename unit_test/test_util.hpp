@@ -0,0 +1,61 @@
+#pragma once
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <dirent.h>
+#include <unistd.h>
+
+/// @brief Random ACGT sequence of len (> 0) characters, the last one
+///        A standing for $
+inline std::string random_dna(std::size_t len, unsigned seed)
+{
+    std::default_random_engine eng(seed);
+    std::uniform_int_distribution<int> dist(0, 3);
+    std::string seq(len, 'A');
+    std::generate(seq.begin(), seq.end()-1,
+        [&eng, &dist](){ return "ACGT"[dist(eng)]; });
+    return seq;
+}
+
+/// @brief Temporary directory for the files of a test, removed with
+///        them at the end of the scope
+class TempDir
+{
+    std::string path_;
+
+  public:
+    TempDir()
+    {
+        char name[] = "/tmp/fm_index_test.XXXXXX";
+        if (::mkdtemp(name) == nullptr)
+            throw std::runtime_error("can not create temporary directory");
+        path_ = name;
+    }
+
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    ~TempDir()
+    {
+        if (auto dir = ::opendir(path_.c_str()))
+        {
+            while (auto entry = ::readdir(dir))
+            {
+                std::string name(entry->d_name);
+                if (name != "." && name != "..")
+                    ::unlink(file(name).c_str());
+            }
+            ::closedir(dir);
+        }
+        ::rmdir(path_.c_str());
+    }
+
+    const std::string& path() const
+    { return path_; }
+
+    /// @brief Path of a file in the directory
+    std::string file(const std::string& name) const
+    { return path_ + "/" + name; }
+};